@@ -25,12 +25,45 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <fstream>
-#include <sstream>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <zlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef HAVE_ZSTD
+#  include <zstd.h>
+#endif
+#ifdef HAVE_IO_URING
+#  include <liburing.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#  define HAVE_MMAP 1
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+#ifdef __linux__
+#  include <sys/syscall.h>
+#endif
+
 
 /*
  * A Python object responsible for memory management of our vectors.
@@ -59,10 +92,10 @@ static void destroy_vector_owner(PyObject *self)
 }
 
 /*
- * Since a template function can't have C linkage,
- * we instantiate the template for the types "int" and "double"
- * in the following two functions. These are used for the tp_dealloc
- * attribute of the vector owner types further below.
+ * Since a template function can't have C linkage, we instantiate the
+ * template for each supported element type in the following functions.
+ * These are used for the tp_dealloc attribute of the vector owner types
+ * further below.
  */
 extern "C" {
 static void destroy_int_vector(PyObject *self)
@@ -70,6 +103,16 @@ static void destroy_int_vector(PyObject *self)
   destroy_vector_owner<int>(self);
 }
 
+static void destroy_longlong_vector(PyObject *self)
+{
+  destroy_vector_owner<long long>(self);
+}
+
+static void destroy_float_vector(PyObject *self)
+{
+  destroy_vector_owner<float>(self);
+}
+
 static void destroy_double_vector(PyObject *self)
 {
   destroy_vector_owner<double>(self);
@@ -77,37 +120,86 @@ static void destroy_double_vector(PyObject *self)
 }
 
 
+/*
+ * A Python object responsible for unmapping a cache file mapping shared
+ * by several ndarrays; its refcount counts the arrays viewing it.
+ */
+struct MmapOwner {
+  PyObject_HEAD
+  void *addr;
+  size_t size;
+};
+
+extern "C" {
+static void destroy_mmap_owner(PyObject *self)
+{
+#ifdef HAVE_MMAP
+  MmapOwner &obj = *reinterpret_cast<MmapOwner *>(self);
+  if (obj.addr)
+    ::munmap(obj.addr, obj.size);
+#endif
+  self->ob_type->tp_free(self);
+}
+}
+
 /*
  * Type objects for above.
  */
-static PyTypeObject IntVOwnerType    = { PyObject_HEAD_INIT(NULL) },
-                    DoubleVOwnerType = { PyObject_HEAD_INIT(NULL) };
+static PyTypeObject IntVOwnerType      = { PyObject_HEAD_INIT(NULL) },
+                    LongLongVOwnerType = { PyObject_HEAD_INIT(NULL) },
+                    FloatVOwnerType    = { PyObject_HEAD_INIT(NULL) },
+                    DoubleVOwnerType   = { PyObject_HEAD_INIT(NULL) },
+                    MmapOwnerType      = { PyObject_HEAD_INIT(NULL) };
+
+static PyTypeObject *owner_types[] = {
+  &IntVOwnerType, &LongLongVOwnerType, &FloatVOwnerType,
+  &DoubleVOwnerType, &MmapOwnerType, 0
+};
 
 /*
  * Set the fields of the owner type objects.
  */
 static void init_type_objs()
 {
-  IntVOwnerType.tp_flags = DoubleVOwnerType.tp_flags = Py_TPFLAGS_DEFAULT;
-  IntVOwnerType.tp_name  = DoubleVOwnerType.tp_name  = "deallocator";
-  IntVOwnerType.tp_doc   = DoubleVOwnerType.tp_doc   = "deallocator object";
-  IntVOwnerType.tp_new   = DoubleVOwnerType.tp_new   = PyType_GenericNew;
+  for (PyTypeObject **t = owner_types; *t; ++t) {
+    (*t)->tp_flags = Py_TPFLAGS_DEFAULT;
+    (*t)->tp_name  = "deallocator";
+    (*t)->tp_doc   = "deallocator object";
+    (*t)->tp_new   = PyType_GenericNew;
+  }
 
-  IntVOwnerType.tp_basicsize     = sizeof(VectorOwner<int>);
-  DoubleVOwnerType.tp_basicsize  = sizeof(VectorOwner<double>);
-  IntVOwnerType.tp_dealloc       = destroy_int_vector;
-  DoubleVOwnerType.tp_dealloc    = destroy_double_vector;
+  IntVOwnerType.tp_basicsize      = sizeof(VectorOwner<int>);
+  LongLongVOwnerType.tp_basicsize = sizeof(VectorOwner<long long>);
+  FloatVOwnerType.tp_basicsize    = sizeof(VectorOwner<float>);
+  DoubleVOwnerType.tp_basicsize   = sizeof(VectorOwner<double>);
+  MmapOwnerType.tp_basicsize      = sizeof(MmapOwner);
+  IntVOwnerType.tp_dealloc        = destroy_int_vector;
+  LongLongVOwnerType.tp_dealloc   = destroy_longlong_vector;
+  FloatVOwnerType.tp_dealloc      = destroy_float_vector;
+  DoubleVOwnerType.tp_dealloc     = destroy_double_vector;
+  MmapOwnerType.tp_dealloc        = destroy_mmap_owner;
 }
 
 PyTypeObject &vector_owner_type(int typenum)
 {
   switch (typenum) {
     case NPY_INT: return IntVOwnerType;
+    case NPY_LONGLONG: return LongLongVOwnerType;
+    case NPY_FLOAT: return FloatVOwnerType;
     case NPY_DOUBLE: return DoubleVOwnerType;
   }
   throw std::logic_error("invalid argument to vector_owner_type");
 }
 
+/*
+ * Map the supported C++ element types to their numpy type numbers.
+ */
+template <typename T> struct numpy_type {};
+template <> struct numpy_type<int>       { enum { typenum = NPY_INT }; };
+template <> struct numpy_type<long long> { enum { typenum = NPY_LONGLONG }; };
+template <> struct numpy_type<float>     { enum { typenum = NPY_FLOAT }; };
+template <> struct numpy_type<double>    { enum { typenum = NPY_DOUBLE }; };
+
 
 /*
  * Convert a C++ vector to a 1d-ndarray WITHOUT memory copying.
@@ -148,10 +240,13 @@ static PyObject *to_1d_array(std::vector<T> &v, int typenum)
 }
 
 
-static PyObject *to_csr(std::vector<double> &data,
-                        std::vector<int> &indices,
-                        std::vector<int> &indptr,
-                        std::vector<double> &labels)
+template <typename D, typename I>
+static PyObject *to_csr(std::vector<D> &data,
+                        std::vector<I> &indices,
+                        std::vector<I> &indptr,
+                        std::vector<double> &labels,
+                        std::vector<I> &qids,
+                        std::vector<I> &label_indptr)
 {
   // We could do with a smart pointer to Python objects here.
   std::exception const *exc = 0;
@@ -159,17 +254,22 @@ static PyObject *to_csr(std::vector<double> &data,
            *indices_arr = 0,
            *indptr_arr = 0,
            *labels_arr = 0,
+           *qids_arr = 0,
+           *label_indptr_arr = 0,
            *ret_tuple = 0;
 
   try {
-    data_arr    = to_1d_array(data, NPY_DOUBLE);
-    indices_arr = to_1d_array(indices, NPY_INT);
-    indptr_arr  = to_1d_array(indptr, NPY_INT);
+    data_arr    = to_1d_array(data, numpy_type<D>::typenum);
+    indices_arr = to_1d_array(indices, numpy_type<I>::typenum);
+    indptr_arr  = to_1d_array(indptr, numpy_type<I>::typenum);
     labels_arr  = to_1d_array(labels, NPY_DOUBLE);
+    qids_arr    = to_1d_array(qids, numpy_type<I>::typenum);
+    label_indptr_arr = to_1d_array(label_indptr, numpy_type<I>::typenum);
 
-    ret_tuple = Py_BuildValue("OOOO",
+    ret_tuple = Py_BuildValue("OOOOOO",
                               data_arr, indices_arr,
-                              indptr_arr, labels_arr);
+                              indptr_arr, labels_arr, qids_arr,
+                              label_indptr_arr);
   } catch (std::exception const &e) {
     exc = &e;
   }
@@ -181,6 +281,8 @@ static PyObject *to_csr(std::vector<double> &data,
   Py_XDECREF(indices_arr);
   Py_XDECREF(indptr_arr);
   Py_XDECREF(labels_arr);
+  Py_XDECREF(qids_arr);
+  Py_XDECREF(label_indptr_arr);
 
   if (exc)
     throw *exc;
@@ -188,234 +290,3791 @@ static PyObject *to_csr(std::vector<double> &data,
   return ret_tuple;
 }
 
+#ifdef HAVE_MMAP
+#ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static size_t arena_align(size_t n)
+{
+  return (n + 63) & ~size_t(63);    // cache-line align each section
+}
 
 /*
- * Parsing.
+ * NUMA placement for the arena, applied before the copy in so the
+ * pages are faulted under the requested policy. mbind(2) has no libc
+ * wrapper outside libnuma, so the raw syscall is used; on kernels or
+ * platforms without it the call degrades to default first-touch
+ * placement, the same best-effort contract as the hugepage advice.
  */
+enum { NUMA_NONE = 0, NUMA_INTERLEAVE = 1, NUMA_BIND = 2 };
 
-class SyntaxError : public std::runtime_error {
-public:
-  SyntaxError(std::string const &msg)
-   : std::runtime_error(msg + " in SVMlight/libSVM file")
-  {
+#if defined(__linux__) && defined(__NR_mbind)
+#ifndef MPOL_INTERLEAVE
+#  define MPOL_BIND 2
+#  define MPOL_INTERLEAVE 3
+#endif
+
+static void apply_numa_policy(void *addr, size_t len,
+                              int policy, long node)
+{
+  unsigned long nodemask;
+  int mode;
+
+  if (policy == NUMA_INTERLEAVE) {
+    mode = MPOL_INTERLEAVE;
+    nodemask = ~0UL;            // all allowed nodes
+  } else if (policy == NUMA_BIND
+             && node >= 0 && node < long(sizeof(nodemask) * 8)) {
+    mode = MPOL_BIND;
+    nodemask = 1UL << node;
+  } else {
+    return;
   }
-};
+  ::syscall(__NR_mbind, addr, len, mode, &nodemask,
+            sizeof(nodemask) * 8, 0);
+}
+#else
+static void apply_numa_policy(void *, size_t, int, long)
+{
+}
+#endif
 
 /*
- * Parse single line. Throws exception on failure.
+ * Variant of to_csr that packs the four arrays into one anonymous
+ * mapping advised for transparent huge pages, instead of leaving them
+ * in separate heap allocations on 4K pages. For very large results this
+ * cuts dTLB pressure when downstream code walks the arrays; the copy
+ * out of the parse vectors runs at memory bandwidth, well under the
+ * cost of the parse that produced them. The mapping is shared by the
+ * arrays through an MmapOwner and unmapped when the last one dies.
  */
-void parse_line(const std::string& line,
-                std::vector<double> &data,
-                std::vector<int> &indices,
-                std::vector<int> &indptr,
-                std::vector<double> &labels)
+template <typename D, typename I>
+static PyObject *to_csr_arena(std::vector<D> &data,
+                              std::vector<I> &indices,
+                              std::vector<I> &indptr,
+                              std::vector<double> &labels,
+                              std::vector<I> &qids,
+                              std::vector<I> &label_indptr,
+                              bool hugepages,
+                              int numa_policy, long numa_node)
 {
-  if (line.length() == 0)
-    throw SyntaxError("empty line");
+  size_t data_off    = 0;
+  size_t indices_off = data_off + arena_align(data.size() * sizeof(D));
+  size_t indptr_off  = indices_off + arena_align(indices.size() * sizeof(I));
+  size_t labels_off  = indptr_off + arena_align(indptr.size() * sizeof(I));
+  size_t qids_off    = labels_off
+                     + arena_align(labels.size() * sizeof(double));
+  size_t li_off      = qids_off + arena_align(qids.size() * sizeof(I));
+  size_t total       = li_off
+                     + arena_align(label_indptr.size() * sizeof(I));
+
+  if (total == 0)
+    total = 1;
+
+  void *addr = ::mmap(0, total, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED)
+    // plain heap fallback
+    return to_csr(data, indices, indptr, labels, qids, label_indptr);
+#ifdef MADV_HUGEPAGE
+  if (hugepages)
+    ::madvise(addr, total, MADV_HUGEPAGE);
+#endif
+  apply_numa_policy(addr, total, numa_policy, numa_node);
+
+  char *base = (char *)addr;
+  if (!data.empty())
+    std::memcpy(base + data_off, &data[0], data.size() * sizeof(D));
+  if (!indices.empty())
+    std::memcpy(base + indices_off, &indices[0],
+                indices.size() * sizeof(I));
+  if (!indptr.empty())
+    std::memcpy(base + indptr_off, &indptr[0], indptr.size() * sizeof(I));
+  if (!labels.empty())
+    std::memcpy(base + labels_off, &labels[0],
+                labels.size() * sizeof(double));
+  if (!qids.empty())
+    std::memcpy(base + qids_off, &qids[0], qids.size() * sizeof(I));
+  if (!label_indptr.empty())
+    std::memcpy(base + li_off, &label_indptr[0],
+                label_indptr.size() * sizeof(I));
+
+  MmapOwner *owner = PyObject_New(MmapOwner, &MmapOwnerType);
+  if (!owner) {
+    ::munmap(addr, total);
+    throw std::bad_alloc();
+  }
+  owner->addr = addr;
+  owner->size = total;
+
+  npy_intp nnz = data.size(), n_indptr = indptr.size(),
+           n_samples = labels.size(), n_qids = qids.size(),
+           n_li = label_indptr.size();
+
+  PyObject *data_arr = PyArray_SimpleNewFromData(
+      1, &nnz, numpy_type<D>::typenum, base + data_off);
+  PyObject *indices_arr = PyArray_SimpleNewFromData(
+      1, &nnz, numpy_type<I>::typenum, base + indices_off);
+  PyObject *indptr_arr = PyArray_SimpleNewFromData(
+      1, &n_indptr, numpy_type<I>::typenum, base + indptr_off);
+  PyObject *labels_arr = PyArray_SimpleNewFromData(
+      1, &n_samples, NPY_DOUBLE, base + labels_off);
+  PyObject *qids_arr = PyArray_SimpleNewFromData(
+      1, &n_qids, numpy_type<I>::typenum, base + qids_off);
+  PyObject *label_indptr_arr = PyArray_SimpleNewFromData(
+      1, &n_li, numpy_type<I>::typenum, base + li_off);
+
+  PyObject *ret_tuple = 0;
+  if (data_arr && indices_arr && indptr_arr && labels_arr && qids_arr
+      && label_indptr_arr) {
+    // Each array holds its own reference to the shared owner.
+    PyArray_BASE(data_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(indices_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(indptr_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(labels_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(qids_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(label_indptr_arr) = (PyObject *)owner;
+
+    ret_tuple = Py_BuildValue("OOOOOO", data_arr, indices_arr,
+                              indptr_arr, labels_arr, qids_arr,
+                              label_indptr_arr);
+  } else {
+    Py_DECREF(owner);   // unmaps the arena
+  }
 
-  if (line[0] == '#')
-    return;
+  Py_XDECREF(data_arr);
+  Py_XDECREF(indices_arr);
+  Py_XDECREF(indptr_arr);
+  Py_XDECREF(labels_arr);
+  Py_XDECREF(qids_arr);
+  Py_XDECREF(label_indptr_arr);
 
-  // FIXME: we shouldn't be parsing line-by-line.
-  // Also, we might catch more syntax errors with failbit.
-  std::istringstream in(line);
-  in.exceptions(std::ios::badbit);
+  if (!ret_tuple)
+    throw std::bad_alloc();
 
-  double y;
-  if (!(in >> y)) {
-    throw SyntaxError("non-numeric or missing label");
-  }
+  // The heap copies are dead weight now; drop them before returning so
+  // peak memory is arena + vectors only transiently.
+  std::vector<D>().swap(data);
+  std::vector<I>().swap(indices);
+  std::vector<I>().swap(indptr);
+  std::vector<double>().swap(labels);
+  std::vector<I>().swap(qids);
+  std::vector<I>().swap(label_indptr);
+
+  return ret_tuple;
+}
+#endif  // HAVE_MMAP
 
-  labels.push_back(y);
-  indptr.push_back(data.size());
 
-  char c;
-  double x;
-  unsigned idx;
+/*
+ * Binary cache sidecar. After a first text parse the four raw arrays are
+ * written page-aligned behind a small header; subsequent loads mmap the
+ * cache and build the ndarrays directly over the mapping, so reloading
+ * costs page table setup instead of a full reparse.
+ */
 
-  while (in >> idx >> c >> x) {
-    if (c != ':')
-      throw SyntaxError(std::string("expected ':', got '") + c + "'");
-    indices.push_back(int(idx));
-    data.push_back(x);
-  }
+static const char CACHE_MAGIC[8] =
+  { 'S', 'V', 'M', 'L', 'C', 'S', 'R', '\0' };
+static const unsigned long long CACHE_VERSION = 4;
+static const size_t CACHE_PAGE = 4096;
+
+struct CacheHeader {
+  char magic[8];
+  unsigned long long version;
+  unsigned long long value_size;        // sizeof the data elements
+  unsigned long long index_size;        // sizeof the indices/indptr elements
+  unsigned long long zero_based_mode;   // ZERO_BASED_* the cache was built with
+  unsigned long long n_samples;
+  unsigned long long nnz;
+  unsigned long long n_qids;              // n_samples or 0 (no qid tokens)
+  unsigned long long data_offset;
+  unsigned long long indices_offset;
+  unsigned long long indptr_offset;
+  unsigned long long labels_offset;
+  unsigned long long qids_offset;
+};
+
+static size_t cache_align(size_t n)
+{
+  return (n + CACHE_PAGE - 1) & ~(CACHE_PAGE - 1);
 }
 
 /*
- * Parse entire file. Throws exception on failure.
+ * Best-effort cache writer: a load must not fail because its cache
+ * could not be written, so errors just leave the cache absent.
  */
-void parse_file(char const *file_path,
-                size_t buffer_size,
-                std::vector<double> &data,
-                std::vector<int> &indices,
-                std::vector<int> &indptr,
-                std::vector<double> &labels)
+template <typename D, typename I>
+static void write_cache(std::string const &cache_path,
+                        std::vector<D> const &data,
+                        std::vector<I> const &indices,
+                        std::vector<I> const &indptr,
+                        std::vector<double> const &labels,
+                        std::vector<I> const &qids,
+                        int zero_based_mode)
 {
-  std::vector<char> buffer(buffer_size);
+  CacheHeader h;
+  std::memcpy(h.magic, CACHE_MAGIC, sizeof(h.magic));
+  h.version = CACHE_VERSION;
+  h.value_size = sizeof(D);
+  h.index_size = sizeof(I);
+  h.zero_based_mode = zero_based_mode;
+  h.n_samples = labels.size();
+  h.nnz = data.size();
+  h.n_qids = qids.size();
+  h.data_offset    = cache_align(sizeof(CacheHeader));
+  h.indices_offset = h.data_offset
+                   + cache_align(data.size() * sizeof(D));
+  h.indptr_offset  = h.indices_offset
+                   + cache_align(indices.size() * sizeof(I));
+  h.labels_offset  = h.indptr_offset
+                   + cache_align(indptr.size() * sizeof(I));
+  h.qids_offset    = h.labels_offset
+                   + cache_align(labels.size() * sizeof(double));
+
+  std::ofstream out(cache_path.c_str(),
+                    std::ios::binary | std::ios::trunc);
+  if (!out)
+    return;
 
-  std::ifstream file_stream;
-  file_stream.exceptions(std::ios::badbit);
-  file_stream.rdbuf()->pubsetbuf(&buffer[0], buffer_size);
-  file_stream.open(file_path);
+  // &v[0] on an empty vector is undefined; an all-comment file has no
+  // data, indices or labels at all.
+  out.write((const char *)&h, sizeof(h));
+  if (!data.empty()) {
+    out.seekp(h.data_offset);
+    out.write((const char *)&data[0], data.size() * sizeof(D));
+  }
+  if (!indices.empty()) {
+    out.seekp(h.indices_offset);
+    out.write((const char *)&indices[0], indices.size() * sizeof(I));
+  }
+  if (!indptr.empty()) {
+    out.seekp(h.indptr_offset);
+    out.write((const char *)&indptr[0], indptr.size() * sizeof(I));
+  }
+  if (!labels.empty()) {
+    out.seekp(h.labels_offset);
+    out.write((const char *)&labels[0], labels.size() * sizeof(double));
+  }
+  if (!qids.empty()) {
+    out.seekp(h.qids_offset);
+    out.write((const char *)&qids[0], qids.size() * sizeof(I));
+  }
 
-  if (!file_stream)
-    throw std::ios_base::failure("File doesn't exist!");
+  if (!out)
+    std::remove(cache_path.c_str());    // don't leave a truncated cache
+}
 
-  std::string line;
-  while (std::getline(file_stream, line))
-    parse_line(line, data, indices, indptr, labels);
-  indptr.push_back(data.size());
+#ifdef HAVE_MMAP
+/*
+ * True if the cache sidecar exists and is at least as new as the source.
+ */
+static bool cache_is_fresh(char const *file_path,
+                           std::string const &cache_path)
+{
+  struct stat src, cache;
+  return ::stat(file_path, &src) == 0
+      && ::stat(cache_path.c_str(), &cache) == 0
+      && cache.st_mtime >= src.st_mtime;
 }
 
+/*
+ * Map a cache file and build the result tuple over the mapping. The
+ * mapping is private (copy-on-write) so callers may modify the arrays
+ * without touching the cache. Returns 0, with no Python exception set,
+ * if the cache is unreadable or malformed; callers then reparse.
+ */
+template <typename D, typename I>
+static PyObject *load_cache(std::string const &cache_path,
+                            int zero_based_mode)
+{
+  int fd = ::open(cache_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
 
-static const char load_svmlight_file_doc[] =
-  "Load file in svmlight format and return a CSR.";
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+    ::close(fd);
+    return 0;
+  }
 
-extern "C" {
-static PyObject *load_svmlight_file(PyObject *self, PyObject *args)
-{
-  try {
-    // Read function arguments.
-    char const *file_path;
-    int buffer_mb;
+  size_t size = st.st_size;
+  void *addr = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED)
+    return 0;
 
-    if (!PyArg_ParseTuple(args, "si", &file_path, &buffer_mb))
-      return 0;
+  CacheHeader const &h = *(CacheHeader const *)addr;
+  if (std::memcmp(h.magic, CACHE_MAGIC, sizeof(h.magic)) != 0
+      || h.version != CACHE_VERSION
+      || h.value_size != sizeof(D)      // cached with another dtype:
+      || h.index_size != sizeof(I)      // reparse rather than convert
+      // The indices were shifted (or not) under the zero_based mode the
+      // cache was built with; a different request must reparse.
+      || h.zero_based_mode != (unsigned long long)zero_based_mode
+      // Without qids the file ends at the label section; qids_offset
+      // points past EOF (it is the aligned end of the labels), so only
+      // bound-check it when a qid section was actually written.
+      || (h.n_qids
+          ? h.qids_offset + h.n_qids * sizeof(I) > size
+          : h.labels_offset + h.n_samples * sizeof(double) > size)) {
+    ::munmap(addr, size);
+    return 0;
+  }
 
-    buffer_mb = std::max(buffer_mb, 1);
-    size_t buffer_size = buffer_mb * 1024 * 1024;
+  MmapOwner *owner = PyObject_New(MmapOwner, &MmapOwnerType);
+  if (!owner) {
+    ::munmap(addr, size);
+    PyErr_Clear();
+    return 0;
+  }
+  owner->addr = addr;
+  owner->size = size;
+
+  npy_intp nnz = h.nnz, n_samples = h.n_samples, n_indptr = n_samples + 1,
+           n_qids = h.n_qids;
+  char *base = (char *)addr;
+
+  PyObject *data_arr = PyArray_SimpleNewFromData(
+      1, &nnz, numpy_type<D>::typenum, base + h.data_offset);
+  PyObject *indices_arr = PyArray_SimpleNewFromData(
+      1, &nnz, numpy_type<I>::typenum, base + h.indices_offset);
+  PyObject *indptr_arr = PyArray_SimpleNewFromData(
+      1, &n_indptr, numpy_type<I>::typenum, base + h.indptr_offset);
+  PyObject *labels_arr = PyArray_SimpleNewFromData(
+      1, &n_samples, NPY_DOUBLE, base + h.labels_offset);
+  PyObject *qids_arr = PyArray_SimpleNewFromData(
+      1, &n_qids, numpy_type<I>::typenum, base + h.qids_offset);
+  // Multilabel results are never cached, so the ragged label_indptr
+  // component is always empty here.
+  npy_intp n_li = 0;
+  PyObject *label_indptr_arr = PyArray_SimpleNewFromData(
+      1, &n_li, numpy_type<I>::typenum, base + h.qids_offset);
+
+  PyObject *ret_tuple = 0;
+  if (data_arr && indices_arr && indptr_arr && labels_arr && qids_arr
+      && label_indptr_arr) {
+    // Each array holds its own reference to the shared owner.
+    PyArray_BASE(data_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(indices_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(indptr_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(labels_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(qids_arr) = (PyObject *)owner;
+    Py_INCREF(owner);
+    PyArray_BASE(label_indptr_arr) = (PyObject *)owner;
+
+    ret_tuple = Py_BuildValue("OOOOOO", data_arr, indices_arr,
+                              indptr_arr, labels_arr, qids_arr,
+                              label_indptr_arr);
+  } else {
+    PyErr_Clear();
+    Py_DECREF(owner);
+  }
 
-    std::vector<double> data, labels;
-    std::vector<int> indices, indptr;
-    parse_file(file_path, buffer_size, data, indices, indptr, labels);
+  Py_XDECREF(data_arr);
+  Py_XDECREF(indices_arr);
+  Py_XDECREF(indptr_arr);
+  Py_XDECREF(labels_arr);
+  Py_XDECREF(qids_arr);
+  Py_XDECREF(label_indptr_arr);
 
-    return to_csr(data, indices, indptr, labels);
+  return ret_tuple;
+}
+#endif  // HAVE_MMAP
 
-  } catch (SyntaxError const &e) {
-    PyErr_SetString(PyExc_ValueError, e.what());
-    return 0;
-  } catch (std::bad_alloc const &e) {
-    PyErr_SetString(PyExc_MemoryError, e.what());
-    return 0;
-  } catch (std::ios_base::failure const &e) {
-    PyErr_SetString(PyExc_IOError, e.what());
-    return 0;
-  } catch (std::exception const &e) {
-    std::string msg("error in SVMlight/libSVM reader: ");
-    msg += e.what();
-    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
-    return 0;
+
+/*
+ * Parsing.
+ */
+
+class SyntaxError : public std::runtime_error {
+public:
+  SyntaxError(std::string const &msg)
+   : std::runtime_error(msg + " in SVMlight/libSVM file")
+  {
   }
+};
+
+/*
+ * Hand-rolled scanners over a raw character range. These replace the
+ * per-line istringstream: no allocation, no locale machinery, and each
+ * byte of the line is touched roughly once.
+ */
+
+static inline const char *skip_blanks(const char *p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    ++p;
+  return p;
 }
+
+/*
+ * Scan a run of decimal digits into an unsigned feature index.
+ * The digit test is a single unsigned comparison per byte, so the loop
+ * is branch-predictable and amenable to vectorization.
+ * Returns false (leaving p untouched) if no digit is present.
+ */
+static inline bool scan_index(const char *&p, const char *end, unsigned &idx)
+{
+  const char *start = p;
+  unsigned v = 0;
+
+  while (p < end) {
+    unsigned d = (unsigned char)*p - '0';
+    if (d > 9)
+      break;
+    v = v * 10 + d;
+    ++p;
+  }
+
+  if (p == start)
+    return false;
+  idx = v;
+  return true;
 }
 
-static const char dump_svmlight_file_doc[] =
-  "Dump CSR matrix to a file in svmlight format.";
+/* Exact powers of ten up to 10^22, the largest representable in a double. */
+static const double pow10_table[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-extern "C" {
-static PyObject *dump_svmlight_file(PyObject *self, PyObject *args)
+/*
+ * Scan a floating-point value. The fast path accumulates the decimal
+ * mantissa in a 64-bit integer and applies the exponent with one exact
+ * multiply or divide; when mantissa and exponent both fit, this computes
+ * the correctly rounded result (the Eisel-Lemire precondition). Longer
+ * or more extreme numbers take the strtod fallback, which is rare in
+ * real svmlight data. Returns false (leaving p untouched) on no number.
+ */
+static bool scan_double(const char *&p, const char *end, double &out)
 {
-  try {
-    // Read function arguments.
-    char const *file_path;
-    PyArrayObject *indices_array, *indptr_array, *data_array, *label_array;
-    int zero_based;
+  const char *start = p;
+  bool negative = false;
 
-    if (!PyArg_ParseTuple(args,
-                          "sO!O!O!O!i",
-                          &file_path,
-                          &PyArray_Type, &data_array,
-                          &PyArray_Type, &indices_array,
-                          &PyArray_Type, &indptr_array,
-                          &PyArray_Type, &label_array,
-                          &zero_based))
-      return 0;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = (*p == '-');
+    ++p;
+  }
 
-    int n_samples = indptr_array->dimensions[0] - 1;
-    double *data = (double*) data_array->data;
-    int *indices = (int*) indices_array->data;
-    int *indptr = (int*) indptr_array->data;
-    double *y = (double*) label_array->data;
+  unsigned long long mantissa = 0;
+  int n_digits = 0, exp10 = 0;
+  bool any_digits = false;
+
+  while (p < end) {
+    unsigned d = (unsigned char)*p - '0';
+    if (d > 9)
+      break;
+    if (n_digits < 19) {
+      mantissa = mantissa * 10 + d;
+      ++n_digits;
+    } else {
+      ++exp10;              // excess integer digits shift the exponent
+    }
+    ++p;
+    any_digits = true;
+  }
 
-    std::ofstream fout;
-    fout.open(file_path, std::ofstream::out);
-
-    int idx;
-    for (int i=0; i < n_samples; i++) {
-      fout << y[i] << " ";
-      for (int jj=indptr[i]; jj < indptr[i+1]; jj++) {
-        idx = indices[jj];
-        if (!zero_based)
-          idx++;
-        fout << idx << ":" << data[jj] << " ";
+  if (p < end && *p == '.') {
+    ++p;
+    while (p < end) {
+      unsigned d = (unsigned char)*p - '0';
+      if (d > 9)
+        break;
+      if (n_digits < 19) {
+        mantissa = mantissa * 10 + d;
+        ++n_digits;
+        --exp10;
       }
-      fout << std::endl;
+      ++p;
+      any_digits = true;
     }
+  }
 
-    fout.close();
+  if (!any_digits) {
+    p = start;
+    return false;
+  }
 
-    Py_INCREF(Py_None);
-    return Py_None;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *exp_start = p;
+    ++p;
+    bool exp_negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+      exp_negative = (*p == '-');
+      ++p;
+    }
+    int e = 0;
+    const char *exp_digits = p;
+    while (p < end) {
+      unsigned d = (unsigned char)*p - '0';
+      if (d > 9)
+        break;
+      if (e < 100000)
+        e = e * 10 + d;
+      ++p;
+    }
+    if (p == exp_digits)
+      p = exp_start;        // a bare 'e' is not an exponent; rewind
+    else
+      exp10 += exp_negative ? -e : e;
+  }
 
-  } catch (std::exception const &e) {
-    std::string msg("error in SVMlight/libSVM writer: ");
-    msg += e.what();
-    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
-    return 0;
+  if (mantissa <= (1ULL << 53) && -22 <= exp10 && exp10 <= 22) {
+    double v = (double)mantissa;
+    v = exp10 < 0 ? v / pow10_table[-exp10] : v * pow10_table[exp10];
+    out = negative ? -v : v;
+  } else {
+    // Fall back to strtod on a NUL-terminated copy of the token.
+    char buf[512];
+    size_t n = std::min(sizeof(buf) - 1, size_t(p - start));
+    std::memcpy(buf, start, n);
+    buf[n] = '\0';
+    out = std::strtod(buf, 0);
   }
-}
-}
 
+  return true;
+}
 
 /*
- * Python module setup.
+ * Small open-addressing histogram over label values. Classification
+ * targets have a handful of distinct labels, so lookups are one or
+ * two probes in an L1-resident table; regression targets would grow
+ * it without bound, so past LABEL_HIST_MAX distinct values the
+ * histogram marks itself overflowed and stops (min/max keep going).
  */
+struct LabelHist {
+  enum { LABEL_HIST_MAX = 4096 };
 
-static PyMethodDef svmlight_format_methods[] = {
-  {"_load_svmlight_file", load_svmlight_file,
-    METH_VARARGS, load_svmlight_file_doc},
+  std::vector<double> keys;
+  std::vector<unsigned long long> counts;
+  std::vector<bool> used;
+  size_t n_used;
+  bool overflow;
 
-  {"_dump_svmlight_file", dump_svmlight_file,
-    METH_VARARGS, dump_svmlight_file_doc},
+  LabelHist()
+    : keys(64), counts(64), used(64), n_used(0), overflow(false)
+  {
+  }
 
-  {NULL, NULL, 0, NULL}
+  void add(double y)
+  {
+    if (overflow)
+      return;
+    size_t mask = keys.size() - 1;
+    unsigned long long bits;
+    std::memcpy(&bits, &y, sizeof(bits));
+    size_t i = (size_t)(bits * 0x9e3779b97f4a7c15ULL >> 32) & mask;
+    while (used[i] && keys[i] != y)
+      i = (i + 1) & mask;
+    if (!used[i]) {
+      if (n_used >= LABEL_HIST_MAX) {
+        overflow = true;
+        return;
+      }
+      if (4 * n_used >= 3 * keys.size()) {
+        grow();
+        add(y);
+        return;
+      }
+      used[i] = true;
+      keys[i] = y;
+      ++n_used;
+    }
+    ++counts[i];
+  }
+
+  void grow()
+  {
+    std::vector<double> old_keys;
+    std::vector<unsigned long long> old_counts;
+    std::vector<bool> old_used;
+    old_keys.swap(keys);
+    old_counts.swap(counts);
+    old_used.swap(used);
+    keys.resize(old_keys.size() * 2);
+    counts.resize(old_keys.size() * 2);
+    used.resize(old_keys.size() * 2);
+    n_used = 0;
+    for (size_t i = 0; i < old_keys.size(); ++i)
+      if (old_used[i]) {
+        add(old_keys[i]);
+        size_t mask = keys.size() - 1;
+        unsigned long long bits;
+        std::memcpy(&bits, &old_keys[i], sizeof(bits));
+        size_t j = (size_t)(bits * 0x9e3779b97f4a7c15ULL >> 32) & mask;
+        while (keys[j] != old_keys[i])
+          j = (j + 1) & mask;
+        counts[j] = old_counts[i];
+      }
+  }
 };
 
-static const char svmlight_format_doc[] =
-  "Loader/Writer for svmlight / libsvm datasets - C++ helper routines";
+/*
+ * Opt-in load statistics for diagnosing slow loads: was it I/O,
+ * parsing, or vector reallocation? Collected only when a LoadStats is
+ * attached to Rows, so the production parse keeps its NULL-pointer
+ * fast path; the per-line counters cost one pointer test per row when
+ * enabled and nothing when not.
+ */
+struct LoadStats {
+  // Summary of the target column, built while the labels are still in
+  // cache: running min/max and the class histogram, plus a bounded
+  // nnz-per-row tally (the last bucket counts rows at or past the
+  // cap) for percentile-based sharding decisions.
+  enum { NNZ_HIST_CAP = 65536 };
+
+  LabelHist label_hist;
+  double label_min, label_max;
+  std::vector<unsigned long long> nnz_hist;
+
+  unsigned long long bytes_read;      // raw bytes fed to the parser
+  unsigned long long n_rows, nnz;     // filled in once the parse is done
+  unsigned long long realloc_count;   // data-vector growths (per line)
+  unsigned long long realloc_bytes;   // bytes copied by those growths
+  unsigned long long recovered_lines; // lines cut short at a junk token
+  double read_seconds;   // time blocked on I/O (producer pipelines)
+  double parse_seconds;  // wall time of the whole parse
+  size_t last_capacity;  // data.capacity() after the previous line
+
+  LoadStats()
+    : label_min(std::numeric_limits<double>::infinity()),
+      label_max(-std::numeric_limits<double>::infinity()),
+      bytes_read(0), n_rows(0), nnz(0), realloc_count(0),
+      realloc_bytes(0), recovered_lines(0),
+      read_seconds(0.0), parse_seconds(0.0), last_capacity(0)
+  {
+  }
 
-extern "C" {
-#if PY_MAJOR_VERSION >= 3
-static struct PyModuleDef _svmlight_loader_definition = { 
-    PyModuleDef_HEAD_INIT,
-    "_svmlight_loader",
-    svmlight_format_doc,
-    -1, 
-    svmlight_format_methods
+  void add_label(double y)
+  {
+    label_min = std::min(label_min, y);
+    label_max = std::max(label_max, y);
+    label_hist.add(y);
+  }
+
+  void add_row_nnz(size_t n)
+  {
+    if (n >= NNZ_HIST_CAP)
+      n = NNZ_HIST_CAP;
+    if (n >= nnz_hist.size())
+      nnz_hist.resize(n + 1, 0);
+    ++nnz_hist[n];
+  }
 };
 
-PyMODINIT_FUNC PyInit__svmlight_loader(void)
-{
-  Py_Initialize();
-  import_array();
+/*
+ * Optional feature-subset filter applied inside the parse loop, so
+ * pruned features are never pushed into data/indices at all and peak
+ * memory shrinks by the pruning ratio instead of after a post-load
+ * slice. Ids are feature indices as written in the file, i.e. before
+ * any zero_based shift.
+ */
+struct FeatureFilter {
+  std::vector<unsigned long long> mask;  // bitset over whitelisted ids
+  long max_feature;                      // largest id kept, -1 for none
 
-  init_type_objs();
-  if (PyType_Ready(&DoubleVOwnerType) < 0
-  || PyType_Ready(&IntVOwnerType)    < 0)
-  return NULL;
+  FeatureFilter() : max_feature(-1) {}
 
-  return PyModule_Create(&_svmlight_loader_definition);
+  bool active() const
+  {
+    return max_feature >= 0 || !mask.empty();
+  }
 
-}
-#else 
-PyMODINIT_FUNC init_svmlight_loader(void)
-{
-  _import_array();
+  void set(size_t id)
+  {
+    if (id >= (mask.size() << 6))
+      mask.resize((id >> 6) + 1, 0);
+    mask[id >> 6] |= 1ULL << (id & 63);
+  }
 
-  init_type_objs();
-  if (PyType_Ready(&DoubleVOwnerType) < 0
-   || PyType_Ready(&IntVOwnerType)    < 0)
-    return;
+  // One compare plus a shift-and-mask bitset probe per feature; ids
+  // past the end of the mask fall outside every word and are dropped.
+  bool keep(unsigned id) const
+  {
+    if (max_feature >= 0 && long(id) > max_feature)
+      return false;
+    if (mask.empty())
+      return true;
+    return id < (mask.size() << 6)
+        && ((mask[id >> 6] >> (id & 63)) & 1);
+  }
+};
+
+/*
+ * The output of a parse in progress: the four CSR vectors plus
+ * bookkeeping accumulated in the hot loop.
+ */
+template <typename D, typename I>
+struct Rows {
+  std::vector<D> data;
+  std::vector<double> labels;
+  std::vector<I> indices, indptr;
+
+  // One qid per row for ranking files; stays empty for files without
+  // qid tokens (all-or-nothing, enforced while parsing).
+  std::vector<I> qids;
+
+  // Ragged per-row label lists when multilabel is set: row i's labels
+  // are labels[label_indptr[i]:label_indptr[i+1]]. Empty otherwise,
+  // with exactly one label per row in labels.
+  std::vector<I> label_indptr;
+  bool multilabel;
+
+  // Smallest and largest feature index seen, for zero/one-based
+  // detection and shape inference without re-scanning the finished
+  // indices array; min_index stays at max() (and max_index at -1)
+  // while no feature has been seen.
+  I min_index, max_index;
+
+  // Feature filter consulted in the parse loop, or NULL to keep all.
+  const FeatureFilter *filter;
+
+  // Statistics sink, or NULL to collect nothing.
+  LoadStats *stats;
+
+  // Error-tolerant mode: parse_line_checked rolls malformed lines
+  // back and records their 1-based line numbers instead of letting
+  // the SyntaxError abort the load.
+  bool skip_bad;
+  size_t line_no;
+  std::vector<size_t> bad_lines;
+
+  Rows()
+    : multilabel(false),
+      min_index(std::numeric_limits<I>::max()), max_index(-1),
+      filter(NULL), stats(NULL), skip_bad(false), line_no(0) {}
+
+  // Rows parsed so far; valid until finish() appends the closing
+  // indptr entries.
+  size_t n_rows() const
+  {
+    return multilabel ? label_indptr.size() : labels.size();
+  }
+
+  // Close the ragged arrays once every row is in.
+  void finish()
+  {
+    indptr.push_back(data.size());
+    if (multilabel)
+      label_indptr.push_back(labels.size());
+  }
+};
+
+/*
+ * Restore the per-row CSR invariants for a row whose features arrived
+ * out of order or duplicated: insertion-sort the row's tail of
+ * indices/data (rows are short, and offenders rare enough that a
+ * fancier sort never pays), then merge equal indices by summing their
+ * values, as scipy's sum_duplicates() would. Called only for rows
+ * parse_line flagged, so clean files never enter here.
+ */
+template <typename D, typename I>
+static void fix_row_order(Rows<D, I> &rows, size_t begin)
+{
+  I *index = &rows.indices[begin];
+  D *value = &rows.data[begin];
+  size_t n = rows.data.size() - begin;
+
+  for (size_t i = 1; i < n; ++i) {
+    I ci = index[i];
+    D cv = value[i];
+    size_t j = i;
+    for (; j > 0 && index[j - 1] > ci; --j) {
+      index[j] = index[j - 1];
+      value[j] = value[j - 1];
+    }
+    index[j] = ci;
+    value[j] = cv;
+  }
+
+  size_t out = 0;
+  for (size_t i = 1; i < n; ++i) {
+    if (index[i] == index[out]) {
+      value[out] += value[i];
+    } else {
+      ++out;
+      index[out] = index[i];
+      value[out] = value[i];
+    }
+  }
+  rows.indices.resize(begin + out + 1);
+  rows.data.resize(begin + out + 1);
+}
+
+/*
+ * Parse single line. Throws exception on failure.
+ */
+template <typename D, typename I>
+void parse_line(const char *p, const char *end, Rows<D, I> &rows)
+{
+  if (p == end)
+    throw SyntaxError("empty line");
+
+  if (*p == '#')
+    return;
+
+  p = skip_blanks(p, end);
+
+  double y;
+  if (rows.multilabel) {
+    rows.label_indptr.push_back(rows.labels.size());
+
+    // A row may have no labels at all, in which case its first token
+    // is already a feature; probe for "index:" without consuming.
+    const char *probe = p;
+    unsigned probe_idx;
+    bool have_labels = true;
+    if (scan_index(probe, end, probe_idx)) {
+      probe = skip_blanks(probe, end);
+      if (probe < end && *probe == ':')
+        have_labels = false;
+    }
+
+    if (have_labels) {
+      for (;;) {
+        if (!scan_double(p, end, y))
+          throw SyntaxError("non-numeric or missing label");
+        rows.labels.push_back(y);
+        if (p < end && *p == ',')
+          ++p;
+        else
+          break;
+      }
+    }
+  } else {
+    if (!scan_double(p, end, y)) {
+      throw SyntaxError("non-numeric or missing label");
+    }
+    rows.labels.push_back(y);
+  }
+
+  rows.indptr.push_back(rows.data.size());
+
+  // Optional ranking qid, between the label and the features. Files
+  // must use it on every line or none: a mix would silently misalign
+  // the qid array against the rows.
+  p = skip_blanks(p, end);
+  if (end - p >= 4
+      && p[0] == 'q' && p[1] == 'i' && p[2] == 'd' && p[3] == ':') {
+    p += 4;
+    unsigned q;
+    if (!scan_index(p, end, q))
+      throw SyntaxError("malformed qid");
+    if (rows.qids.size() != rows.n_rows() - 1)
+      throw SyntaxError("qid present on some lines only");
+    rows.qids.push_back(I(q));
+  } else if (!rows.qids.empty()) {
+    throw SyntaxError("qid present on some lines only");
+  }
+
+  unsigned idx;
+  double x;
+  I min_index = rows.min_index;
+  I max_index = rows.max_index;
+  const FeatureFilter *filter = rows.filter;
+
+  // Sorted-indices guarantee: one compare against the previous index
+  // per feature; only rows that actually violate it get repaired.
+  size_t row_begin = rows.data.size();
+  I prev_index = -1;
+  bool row_dirty = false;
+
+  for (;;) {
+    p = skip_blanks(p, end);
+    // A '#' starts a trailing comment; everything after it is dropped.
+    if (p < end && *p == '#')
+      break;
+    // Like the istringstream extractor this replaces, a trailing token
+    // that does not start a feature ends the line silently.
+    if (!scan_index(p, end, idx))
+      break;
+    p = skip_blanks(p, end);
+    if (p == end)
+      break;
+    if (*p != ':')
+      throw SyntaxError(std::string("expected ':', got '") + *p + "'");
+    ++p;
+    p = skip_blanks(p, end);
+    if (!scan_double(p, end, x))
+      break;
+    if (filter && !filter->keep(idx))
+      continue;
+    if (I(idx) <= prev_index)
+      row_dirty = true;
+    prev_index = I(idx);
+    min_index = std::min(min_index, I(idx));
+    max_index = std::max(max_index, I(idx));
+    rows.indices.push_back(I(idx));
+    rows.data.push_back(D(x));
+  }
+
+  if (row_dirty)
+    fix_row_order(rows, row_begin);
+
+  rows.min_index = min_index;
+  rows.max_index = max_index;
+
+  if (LoadStats *stats = rows.stats) {
+    // Summarize the row while its label and nonzeros are still hot.
+    size_t labels_begin = rows.multilabel
+      ? size_t(rows.label_indptr.back()) : rows.labels.size() - 1;
+    for (size_t i = labels_begin; i < rows.labels.size(); ++i)
+      stats->add_label(rows.labels[i]);
+    stats->add_row_nnz(rows.data.size() - row_begin);
+
+    // Reallocations are detected at line granularity: cheap, and a
+    // growth spree within one line still shows up as a growth.
+    size_t capacity = rows.data.capacity();
+    if (capacity != stats->last_capacity) {
+      ++stats->realloc_count;
+      stats->realloc_bytes += stats->last_capacity * sizeof(D);
+      stats->last_capacity = capacity;
+    }
+    // The feature loop ended before the line did on something other
+    // than a comment: the silent-recovery path inherited from the
+    // istringstream reader.
+    if (p < end && *p != '#')
+      ++stats->recovered_lines;
+  }
+}
+
+template <typename D, typename I>
+void parse_line(const std::string &line, Rows<D, I> &rows)
+{
+  parse_line(line.data(), line.data() + line.size(), rows);
+}
+
+/*
+ * parse_line plus a row-boundary rollback: a malformed line never
+ * leaves a partial row behind. In skip_bad mode the line is
+ * quarantined (its number recorded) and parsing continues, so one
+ * corrupt row costs one row instead of the whole load; otherwise the
+ * error propagates, but accumulating callers (the CSR builder) keep
+ * the rows parsed before it. The clean-file path pays a line counter
+ * and the size snapshots per row.
+ */
+template <typename D, typename I>
+void parse_line_checked(const char *p, const char *end, Rows<D, I> &rows)
+{
+  ++rows.line_no;
+
+  size_t n_nnz    = rows.data.size();
+  size_t n_labels = rows.labels.size();
+  size_t n_indptr = rows.indptr.size();
+  size_t n_qids   = rows.qids.size();
+  size_t n_li     = rows.label_indptr.size();
+  try {
+    parse_line(p, end, rows);
+  } catch (SyntaxError const &) {
+    rows.data.resize(n_nnz);
+    rows.indices.resize(n_nnz);
+    rows.labels.resize(n_labels);
+    rows.indptr.resize(n_indptr);
+    rows.qids.resize(n_qids);
+    rows.label_indptr.resize(n_li);
+    if (!rows.skip_bad)
+      throw;
+    rows.bad_lines.push_back(rows.line_no);
+  }
+}
+
+template <typename D, typename I>
+void parse_line_checked(const std::string &line, Rows<D, I> &rows)
+{
+  parse_line_checked(line.data(), line.data() + line.size(), rows);
+}
+
+/*
+ * Options controlling a load, threaded through the parse routines.
+ * Defaults reproduce the plain single-threaded parse.
+ */
+// How feature indices in the file relate to column indices. AUTO means
+// one-based if and only if no zero index appears anywhere in the parse.
+enum { ZERO_BASED_FALSE = 0, ZERO_BASED_TRUE = 1, ZERO_BASED_AUTO = 2 };
+
+/*
+ * Output-format selectors: the CSR vectors can be reinterpreted as CSC
+ * or COO before the arrays are built, so solvers that want those
+ * layouts skip the scipy .tocsc() transpose (a second full copy on top
+ * of the CSR one) or the indptr expansion.
+ */
+enum { FORMAT_CSR = 0, FORMAT_CSC = 1, FORMAT_COO = 2 };
+
+struct LoadOptions {
+  size_t buffer_size;     // stdio buffer for the stream fallback
+  unsigned n_threads;     // number of parser threads
+  bool prescan;           // count rows/nnz first and reserve exactly
+  long n_samples_hint;    // known number of rows, -1 if unknown
+  long nnz_hint;          // known number of nonzeros, -1 if unknown
+  int zero_based;         // one of the ZERO_BASED_* constants
+  bool hugepages;         // pack the result into a hugepage arena
+  bool multilabel;        // comma-separated label lists per row
+  long offset;            // byte offset to start at (line-aligned up)
+  long length;            // byte length of the range, -1 for the rest
+  double sample_rate;     // keep each row with this probability
+  unsigned long seed;     // RNG seed for row subsampling
+  FeatureFilter filter;   // optional feature whitelist / index cutoff
+  bool read_ahead;        // reader thread overlaps I/O with parsing
+  bool direct_io;         // io_uring + O_DIRECT read backend
+  bool return_stats;      // collect LoadStats during the parse
+  bool skip_bad;          // quarantine malformed lines instead of throwing
+  int numa_policy;        // NUMA_* placement for the output arena
+  long numa_node;         // node for NUMA_BIND
+  int format;             // FORMAT_* layout of the result arrays
+  long n_cols;            // caller-requested width, -1 to infer
+
+  LoadOptions()
+    : buffer_size(40 * 1024 * 1024), n_threads(1), prescan(false),
+      n_samples_hint(-1), nnz_hint(-1), zero_based(ZERO_BASED_AUTO),
+      hugepages(false), multilabel(false),
+      offset(0), length(-1), sample_rate(1.0), seed(0),
+      read_ahead(false), direct_io(false), return_stats(false),
+      skip_bad(false),
+      numa_policy(0), numa_node(-1), format(FORMAT_CSR), n_cols(-1)
+  {
+  }
+
+  // True when only part of the file is wanted, which disables the
+  // cache and the split-by-byte-range parallel parser.
+  bool subset() const
+  {
+    return offset > 0 || length >= 0 || sample_rate < 1.0;
+  }
+};
+
+/*
+ * Cheap xorshift64 Bernoulli sampler for row subsampling. Rows that
+ * lose the draw are skipped with a newline scan only: no number
+ * parsing, no vector pushes.
+ */
+struct RowSampler {
+  unsigned long long state;
+  double rate;
+
+  RowSampler(double rate, unsigned long seed)
+    : state(seed ? seed : 0x9e3779b97f4a7c15ULL), rate(rate)
+  {
+  }
+
+  bool keep()
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    // Top 53 bits to a uniform double in [0, 1).
+    return (state >> 11) * (1.0 / 9007199254740992.0) < rate;
+  }
+};
+
+/*
+ * Shift one-based indices down to zero-based in place. min_index is
+ * maintained by parse_line, so the auto decision costs nothing: no
+ * full scan of the finished indices array just to find its minimum.
+ */
+template <typename D, typename I>
+static void apply_zero_based(Rows<D, I> &rows, int zero_based)
+{
+  if (zero_based == ZERO_BASED_TRUE)
+    return;
+  if (zero_based == ZERO_BASED_AUTO
+      && (rows.indices.empty() || rows.min_index == 0))
+    return;
+  for (size_t i = 0; i < rows.indices.size(); ++i)
+    --rows.indices[i];
+  if (!rows.indices.empty()) {
+    --rows.min_index;         // keep the tracked extrema coherent
+    --rows.max_index;
+  }
+}
+
+/*
+ * In-place counting transpose of the parsed CSR into CSC: one
+ * histogram pass over the column indices, a prefix sum, one scatter.
+ * Afterwards rows.data/indices/indptr hold the CSC value, row-index
+ * and column-pointer arrays; rows ascend within each column, so the
+ * result is canonical. n_cols may widen the matrix beyond the largest
+ * index seen (e.g. a caller-supplied n_features).
+ */
+template <typename D, typename I>
+static void transpose_to_csc(Rows<D, I> &rows, long n_cols)
+{
+  size_t nnz = rows.data.size();
+  if (n_cols < long(rows.max_index) + 1)
+    n_cols = long(rows.max_index) + 1;
+
+  std::vector<I> col_ptr(n_cols + 1, 0);
+  for (size_t k = 0; k < nnz; ++k)
+    ++col_ptr[rows.indices[k] + 1];
+  for (long c = 0; c < n_cols; ++c)
+    col_ptr[c + 1] += col_ptr[c];
+
+  std::vector<D> csc_data(nnz);
+  std::vector<I> csc_row(nnz);
+  std::vector<I> cursor(col_ptr.begin(), col_ptr.end() - 1);
+  size_t n_rows = rows.indptr.size() - 1;
+  for (size_t r = 0; r < n_rows; ++r)
+    for (I k = rows.indptr[r]; k < rows.indptr[r + 1]; ++k) {
+      I pos = cursor[rows.indices[k]]++;
+      csc_data[pos] = rows.data[k];
+      csc_row[pos] = I(r);
+    }
+
+  rows.data.swap(csc_data);
+  rows.indices.swap(csc_row);
+  rows.indptr.swap(col_ptr);
+}
+
+/*
+ * Expand the row pointers into one row id per nonzero, turning the
+ * parsed CSR into COO triples (rows.data, rows.indptr, rows.indices) =
+ * (values, row ids, column ids).
+ */
+template <typename D, typename I>
+static void expand_to_coo(Rows<D, I> &rows)
+{
+  std::vector<I> row_ids(rows.data.size());
+  size_t n_rows = rows.indptr.size() - 1;
+  for (size_t r = 0; r < n_rows; ++r)
+    for (I k = rows.indptr[r]; k < rows.indptr[r + 1]; ++k)
+      row_ids[k] = I(r);
+  rows.indptr.swap(row_ids);
+}
+
+/*
+ * Count rows and nonzeros in a raw buffer. With SSE2 this is a single
+ * structural pass in the simdjson stage-1 style: compare sixteen bytes
+ * at a time against '\n' and ':' and popcount the match masks, so the
+ * pre-scan runs at memory bandwidth however dense the colons are. The
+ * fallback is a pair of memchr sweeps, which pay one library call per
+ * occurrence. (The parsers themselves already lean on memchr for
+ * newline structure, so this pre-scan is the one loop left that
+ * touched every byte in scalar code.)
+ */
+#ifdef __SSE2__
+static void count_rows_and_nnz(const char *begin, const char *end,
+                               size_t &n_rows, size_t &nnz)
+{
+  size_t newlines = 0, colons = 0;
+  const char *p = begin;
+
+  const __m128i nl_block    = _mm_set1_epi8('\n');
+  const __m128i colon_block = _mm_set1_epi8(':');
+  for (; end - p >= 16; p += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i *)p);
+    newlines += __builtin_popcount(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, nl_block)));
+    colons += __builtin_popcount(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(block, colon_block)));
+  }
+  for (; p < end; ++p) {
+    newlines += *p == '\n';
+    colons   += *p == ':';
+  }
+
+  n_rows = newlines;
+  if (begin < end && end[-1] != '\n')
+    ++n_rows;               // final line without trailing newline
+  nnz = colons;
+}
+#else
+static void count_rows_and_nnz(const char *begin, const char *end,
+                               size_t &n_rows, size_t &nnz)
+{
+  n_rows = 0;
+  nnz = 0;
+
+  for (const char *p = begin; p < end; ++n_rows) {
+    p = (const char *)std::memchr(p, '\n', end - p);
+    if (!p)
+      break;
+    ++p;
+  }
+  if (begin < end && end[-1] != '\n')
+    ++n_rows;               // final line without trailing newline
+
+  for (const char *p = begin; p < end; ++nnz) {
+    p = (const char *)std::memchr(p, ':', end - p);
+    if (!p)
+      break;
+    ++p;
+  }
+}
+#endif
+
+template <typename D, typename I>
+static void reserve_all(size_t n_rows, size_t nnz, Rows<D, I> &rows)
+{
+  // A feature filter drops an unknown share of the nonzeros; a
+  // full-nnz reservation would reinstate the peak memory the filter
+  // exists to avoid, so let data/indices grow geometrically instead.
+  if (!rows.filter || !rows.filter->active()) {
+    rows.data.reserve(nnz);
+    rows.indices.reserve(nnz);
+  }
+  rows.indptr.reserve(n_rows + 1);
+  rows.labels.reserve(n_rows);
+}
+
+/*
+ * Parse a [begin, end) character range, one line at a time. Does not
+ * append the final indptr entry; callers do that once all ranges are in.
+ */
+template <typename D, typename I>
+void parse_buffer(const char *begin, const char *end, Rows<D, I> &rows)
+{
+  while (begin < end) {
+    const char *nl = (const char *)std::memchr(begin, '\n', end - begin);
+    const char *line_end = nl ? nl : end;
+    parse_line_checked(begin, line_end, rows);
+    begin = nl ? nl + 1 : end;
+  }
+}
+
+#ifdef HAVE_MMAP
+/*
+ * A read-only memory mapping of an input file, advised for sequential
+ * access so the parser scans the page cache directly: no read(2) copies
+ * into a stdio buffer and no per-line std::string growth.
+ */
+class MappedFile {
+public:
+  explicit MappedFile(char const *file_path)
+    : addr_(0), size_(0), usable_(false)
+  {
+    int fd = ::open(file_path, O_RDONLY);
+    if (fd < 0)
+      throw std::ios_base::failure("File doesn't exist!");
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+      if (st.st_size == 0) {
+        usable_ = true;           // an empty regular file maps to nothing
+      } else {
+        void *addr = ::mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+          ::madvise(addr, st.st_size, MADV_SEQUENTIAL);
+          addr_ = (const char *)addr;
+          size_ = st.st_size;
+          usable_ = true;
+        }
+      }
+    }
+    ::close(fd);
+  }
+
+  ~MappedFile()
+  {
+    if (addr_)
+      ::munmap((void *)addr_, size_);
+  }
+
+  // False if the file could not be mapped (not a regular file, or mmap
+  // failed); callers then fall back to the stream reader.
+  bool usable() const { return usable_; }
+  const char *data() const { return addr_; }
+  size_t size() const { return size_; }
+
+private:
+  MappedFile(MappedFile const &);
+  MappedFile &operator=(MappedFile const &);
+
+  const char *addr_;
+  size_t size_;
+  bool usable_;
+};
+
+/*
+ * Line-align a byte position for range loading: the cut falls after the
+ * first newline at or past pos - 1, so a row starting exactly at pos
+ * stays on the right-hand side and consecutive ranges partition the
+ * rows exactly.
+ */
+static const char *range_cut(const char *base, size_t size, long pos)
+{
+  if (pos <= 0)
+    return base;
+  if ((size_t)pos >= size)
+    return base + size;
+  const char *nl = (const char *)std::memchr(base + pos - 1, '\n',
+                                             size - pos + 1);
+  return nl ? nl + 1 : base + size;
+}
+#endif  // HAVE_MMAP
+
+/*
+ * Stream-based reader, used where mmap is unavailable or fails
+ * (non-regular files). buffer_size sets the stdio buffer.
+ */
+template <typename D, typename I>
+void parse_file_stream(char const *file_path,
+                       LoadOptions const &opts,
+                       Rows<D, I> &rows)
+{
+  std::vector<char> buffer(opts.buffer_size);
+
+  std::ifstream file_stream;
+  file_stream.exceptions(std::ios::badbit);
+  file_stream.rdbuf()->pubsetbuf(&buffer[0], opts.buffer_size);
+  file_stream.open(file_path);
+
+  if (!file_stream)
+    throw std::ios_base::failure("File doesn't exist!");
+
+  if (opts.offset > 0 || opts.length >= 0)
+    throw std::runtime_error("offset/length require a regular "
+                             "uncompressed file");
+
+  // No raw buffer to pre-scan here; only explicit hints apply.
+  if (opts.n_samples_hint >= 0 && opts.nnz_hint >= 0
+      && opts.sample_rate >= 1.0)
+    reserve_all(opts.n_samples_hint, opts.nnz_hint, rows);
+
+  RowSampler sampler(opts.sample_rate, opts.seed);
+  std::string line;
+  while (std::getline(file_stream, line)) {
+    if (rows.stats)
+      rows.stats->bytes_read += line.size() + 1;
+    if (sampler.keep())
+      parse_line_checked(line, rows);
+    else
+      ++rows.line_no;
+  }
+  rows.finish();
+}
+
+/*
+ * Transparent decompression. Compressed inputs are detected by their
+ * magic bytes and streamed through a producer thread that hands
+ * decompressed blocks to the parsing thread, so decompression overlaps
+ * parsing instead of requiring a temporary decompressed file.
+ */
+
+enum Compression { COMPRESS_NONE = 0, COMPRESS_GZIP, COMPRESS_ZSTD };
+
+static Compression detect_compression(char const *file_path)
+{
+  std::ifstream in(file_path, std::ios::binary);
+  if (!in)
+    throw std::ios_base::failure("File doesn't exist!");
+
+  unsigned char magic[4] = { 0, 0, 0, 0 };
+  in.read((char *)magic, sizeof(magic));
+
+  if (in.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    return COMPRESS_GZIP;
+  if (in.gcount() >= 4 && magic[0] == 0x28 && magic[1] == 0xb5
+      && magic[2] == 0x2f && magic[3] == 0xfd)
+    return COMPRESS_ZSTD;
+  return COMPRESS_NONE;
+}
+
+/*
+ * Single-slot handoff between a producer thread and the parsing thread.
+ * Blocks are exchanged by swapping vectors, so the producer's working
+ * buffer and the queued block alternate: a classic double buffer.
+ */
+class BlockQueue {
+public:
+  BlockQueue() : full_(false), done_(false) {}
+
+  void push(std::vector<char> &block)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (full_)
+      popped_.wait(lock);
+    block_.swap(block);
+    full_ = true;
+    pushed_.notify_one();
+  }
+
+  void finish()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_ = true;
+    pushed_.notify_one();
+  }
+
+  void fail(std::exception_ptr error)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    error_ = error;
+    done_ = true;
+    pushed_.notify_one();
+  }
+
+  // Returns false at end of stream; rethrows a producer-side error.
+  bool pop(std::vector<char> &block)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!full_ && !done_)
+      pushed_.wait(lock);
+    if (full_) {
+      block.swap(block_);
+      full_ = false;
+      popped_.notify_one();
+      return true;
+    }
+    if (error_)
+      std::rethrow_exception(error_);
+    return false;
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable pushed_, popped_;
+  std::vector<char> block_;
+  bool full_, done_;
+  std::exception_ptr error_;
+};
+
+static void gzip_producer(char const *file_path, size_t block_size,
+                          BlockQueue &queue)
+{
+  gzFile f = gzopen(file_path, "rb");
+  if (!f) {
+    try {
+      throw std::ios_base::failure("File doesn't exist!");
+    } catch (...) {
+      queue.fail(std::current_exception());
+    }
+    return;
+  }
+
+  try {
+    std::vector<char> buf;
+    for (;;) {
+      buf.resize(block_size);
+      int n = gzread(f, &buf[0], block_size);
+      if (n < 0) {
+        int errnum;
+        std::string msg("gzip error: ");
+        msg += gzerror(f, &errnum);
+        throw std::runtime_error(msg);
+      }
+      if (n == 0)
+        break;
+      buf.resize(n);
+      queue.push(buf);
+    }
+    queue.finish();
+  } catch (...) {
+    queue.fail(std::current_exception());
+  }
+  gzclose(f);
+}
+
+#ifdef HAVE_ZSTD
+static void zstd_producer(char const *file_path, size_t block_size,
+                          BlockQueue &queue)
+{
+  ZSTD_DStream *stream = 0;
+  try {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in)
+      throw std::ios_base::failure("File doesn't exist!");
+
+    stream = ZSTD_createDStream();
+    if (!stream)
+      throw std::bad_alloc();
+
+    std::vector<char> cbuf(ZSTD_DStreamInSize()), buf;
+    ZSTD_inBuffer input = { &cbuf[0], 0, 0 };
+
+    for (;;) {
+      if (input.pos == input.size) {
+        in.read(&cbuf[0], cbuf.size());
+        input.size = in.gcount();
+        input.pos = 0;
+        if (input.size == 0)
+          break;
+      }
+      buf.resize(block_size);
+      ZSTD_outBuffer output = { &buf[0], buf.size(), 0 };
+      size_t ret = ZSTD_decompressStream(stream, &output, &input);
+      if (ZSTD_isError(ret))
+        throw std::runtime_error(std::string("zstd error: ")
+                                 + ZSTD_getErrorName(ret));
+      if (output.pos) {
+        buf.resize(output.pos);
+        queue.push(buf);
+      }
+    }
+    queue.finish();
+  } catch (...) {
+    queue.fail(std::current_exception());
+  }
+  if (stream)
+    ZSTD_freeDStream(stream);
+}
+#endif  // HAVE_ZSTD
+
+/*
+ * Parse decompressed blocks as they arrive, carrying the partial line
+ * at each block boundary over to the next block.
+ */
+template <typename D, typename I>
+static void parse_block_stream(BlockQueue &queue, Rows<D, I> &rows)
+{
+  std::string carry;
+  std::vector<char> block;
+  LoadStats *stats = rows.stats;
+
+  for (;;) {
+    if (stats) {
+      std::chrono::steady_clock::time_point t0 =
+          std::chrono::steady_clock::now();
+      bool more = queue.pop(block);
+      stats->read_seconds += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - t0).count();
+      if (!more)
+        break;
+      stats->bytes_read += block.size();
+    } else if (!queue.pop(block)) {
+      break;
+    }
+    const char *begin = &block[0];
+    const char *end = begin + block.size();
+
+    if (!carry.empty()) {
+      const char *nl = (const char *)std::memchr(begin, '\n', end - begin);
+      if (!nl) {
+        carry.append(begin, end);
+        continue;
+      }
+      carry.append(begin, nl);
+      parse_line_checked(carry.data(), carry.data() + carry.size(), rows);
+      carry.clear();
+      begin = nl + 1;
+    }
+
+    // Complete lines end at the last newline; the tail is carried over.
+    const char *tail = end;
+    while (tail > begin && tail[-1] != '\n')
+      --tail;
+    parse_buffer(begin, tail, rows);
+    carry.assign(tail, end);
+  }
+
+  if (!carry.empty())
+    parse_line_checked(carry.data(), carry.data() + carry.size(), rows);
+  rows.finish();
+}
+
+/*
+ * Plain-file producer for the read-ahead pipeline: reads buffer_size
+ * blocks off the file so that the next block's I/O (NFS round trips in
+ * particular) overlaps parsing of the current one.
+ */
+static void file_producer(char const *file_path, size_t block_size,
+                          BlockQueue &queue)
+{
+  try {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in)
+      throw std::ios_base::failure("File doesn't exist!");
+    in.exceptions(std::ios::badbit);
+
+    std::vector<char> buf;
+    for (;;) {
+      buf.resize(block_size);
+      in.read(&buf[0], block_size);
+      size_t n = in.gcount();
+      if (n == 0)
+        break;
+      buf.resize(n);
+      queue.push(buf);
+    }
+    queue.finish();
+  } catch (...) {
+    queue.fail(std::current_exception());
+  }
+}
+
+#ifdef HAVE_IO_URING
+/*
+ * io_uring + O_DIRECT producer. The synchronous producers above keep
+ * exactly one read outstanding, which caps cold-cache NVMe loads at
+ * latency speed; this one keeps URING_DEPTH aligned reads in flight so
+ * the device sees a full queue. Completions can arrive out of order and
+ * are replayed by file offset, so the parser still consumes a
+ * sequential block stream. Files that refuse O_DIRECT (tmpfs, some
+ * network mounts) fall back to the buffered producer.
+ */
+enum {
+  URING_DEPTH = 8,
+  URING_ALIGN = 4096    // O_DIRECT buffer/offset/length granularity
+};
+
+static void uring_producer(char const *file_path, size_t block_size,
+                           BlockQueue &queue)
+{
+  int fd = open(file_path, O_RDONLY | O_DIRECT);
+  if (fd < 0) {
+    file_producer(file_path, block_size, queue);
+    return;
+  }
+
+  struct stat st;
+  struct io_uring ring;
+  if (fstat(fd, &st) < 0 || io_uring_queue_init(URING_DEPTH, &ring, 0) < 0) {
+    close(fd);
+    file_producer(file_path, block_size, queue);
+    return;
+  }
+  unsigned long long file_size = st.st_size;
+
+  block_size = (block_size + URING_ALIGN - 1) & ~(size_t)(URING_ALIGN - 1);
+
+  void *pool = 0;
+  if (posix_memalign(&pool, URING_ALIGN, URING_DEPTH * block_size) != 0)
+    pool = 0;
+
+  // One buffer per ring slot. A slot is ready once slot_done reaches
+  // the block's expected size; reads that come back short (per-request
+  // caps, or EOF inside the last block) are topped up with a follow-up
+  // request for the rest of the aligned block.
+  unsigned long long slot_offset[URING_DEPTH];
+  size_t slot_done[URING_DEPTH];
+  bool slot_ready[URING_DEPTH];
+  unsigned in_flight = 0;
+
+  try {
+    if (!pool)
+      throw std::bad_alloc();
+
+    unsigned long long submit_offset = 0, next_offset = 0;
+    for (unsigned i = 0; i < URING_DEPTH && submit_offset < file_size; ++i) {
+      struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+      io_uring_prep_read(sqe, fd, (char *)pool + i * block_size,
+                         block_size, submit_offset);
+      io_uring_sqe_set_data(sqe, (void *)(size_t)i);
+      slot_offset[i] = submit_offset;
+      slot_done[i] = 0;
+      slot_ready[i] = false;
+      submit_offset += block_size;
+      ++in_flight;
+    }
+    io_uring_submit(&ring);
+
+    std::vector<char> out;
+    while (next_offset < file_size) {
+      // Find the slot holding the next sequential block, reaping
+      // completions until it lands.
+      unsigned slot = URING_DEPTH;
+      for (unsigned i = 0; i < URING_DEPTH; ++i)
+        if (slot_ready[i] && slot_offset[i] == next_offset)
+          slot = i;
+      if (slot == URING_DEPTH) {
+        struct io_uring_cqe *cqe;
+        int rc = io_uring_wait_cqe(&ring, &cqe);
+        if (rc < 0)
+          throw std::runtime_error(std::string("io_uring error: ")
+                                   + strerror(-rc));
+        unsigned i = (unsigned)(size_t)io_uring_cqe_get_data(cqe);
+        long res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        --in_flight;
+        if (res < 0)
+          throw std::runtime_error(std::string("read error: ")
+                                   + strerror(-(int)res));
+        size_t expected = file_size - slot_offset[i] < block_size
+          ? (size_t)(file_size - slot_offset[i]) : block_size;
+        slot_done[i] += res;
+        if (slot_done[i] >= expected) {
+          slot_ready[i] = true;
+        } else if (res == 0) {
+          throw std::runtime_error("unexpected end of file");
+        } else {
+          // Top up to the aligned block end; EOF truncates the tail.
+          struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+          io_uring_prep_read(sqe, fd, (char *)pool + i * block_size
+                             + slot_done[i], block_size - slot_done[i],
+                             slot_offset[i] + slot_done[i]);
+          io_uring_sqe_set_data(sqe, (void *)(size_t)i);
+          ++in_flight;
+          io_uring_submit(&ring);
+        }
+        continue;
+      }
+
+      char *buf = (char *)pool + slot * block_size;
+      out.assign(buf, buf + slot_done[slot]);
+      queue.push(out);
+      next_offset += slot_done[slot];
+
+      if (submit_offset < file_size) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_read(sqe, fd, buf, block_size, submit_offset);
+        io_uring_sqe_set_data(sqe, (void *)(size_t)slot);
+        slot_offset[slot] = submit_offset;
+        slot_done[slot] = 0;
+        slot_ready[slot] = false;
+        submit_offset += block_size;
+        ++in_flight;
+        io_uring_submit(&ring);
+      } else {
+        slot_ready[slot] = false;  // retired
+      }
+    }
+    queue.finish();
+  } catch (...) {
+    queue.fail(std::current_exception());
+  }
+
+  // Reads still in flight target the pool; wait them out before
+  // freeing it.
+  while (in_flight > 0) {
+    struct io_uring_cqe *cqe;
+    if (io_uring_wait_cqe(&ring, &cqe) < 0)
+      break;
+    io_uring_cqe_seen(&ring, cqe);
+    --in_flight;
+  }
+  io_uring_queue_exit(&ring);
+  free(pool);
+  close(fd);
+}
+
+/*
+ * Read the whole file into memory through the ring, for the parallel
+ * parser: it needs the full byte range up front to split into chunks,
+ * and on a cold cache a queue-depth O_DIRECT read beats faulting the
+ * mapping in page by page. Returns false when the file refuses
+ * O_DIRECT, in which case the mmap path is the better one.
+ */
+static bool uring_read_file(char const *file_path, size_t block_size,
+                            std::vector<char> &out)
+{
+  int fd = open(file_path, O_RDONLY | O_DIRECT);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+  close(fd);
+
+  out.reserve(st.st_size);
+  BlockQueue queue;
+  std::thread producer(uring_producer, file_path, block_size,
+                       std::ref(queue));
+  try {
+    std::vector<char> block;
+    while (queue.pop(block))
+      out.insert(out.end(), block.begin(), block.end());
+  } catch (...) {
+    try {
+      std::vector<char> sink;
+      while (queue.pop(sink)) {}
+    } catch (...) {}
+    producer.join();
+    throw;
+  }
+  producer.join();
+  return true;
+}
+#endif  // HAVE_IO_URING
+
+typedef void (*BlockProducer)(char const *, size_t, BlockQueue &);
+
+// Run a producer thread against the parsing thread; the BlockQueue's
+// single slot plus the producer's working buffer form the double
+// buffer.
+template <typename D, typename I>
+static void parse_producer_stream(BlockProducer produce,
+                                  char const *file_path,
+                                  LoadOptions const &opts,
+                                  Rows<D, I> &rows)
+{
+  BlockQueue queue;
+  std::thread producer(produce, file_path, opts.buffer_size,
+                       std::ref(queue));
+
+  try {
+    parse_block_stream(queue, rows);
+  } catch (...) {
+    // Unblock and drain the producer before leaving.
+    try {
+      std::vector<char> sink;
+      while (queue.pop(sink)) {}
+    } catch (...) {}
+    producer.join();
+    throw;
+  }
+  producer.join();
+}
+
+/*
+ * Serial parse of an in-memory byte range: the common path for mapped
+ * files and for buffer-protocol input, honoring byte-range cuts,
+ * subsampling and the pre-scan reservation.
+ */
+template <typename D, typename I>
+void parse_memory(const char *data, size_t size,
+                  LoadOptions const &opts,
+                  Rows<D, I> &rows)
+{
+  // Cut the byte range on line boundaries the same way the parallel
+  // parser splits chunks: a range starts after the first newline at
+  // or past offset - 1 and runs through the end of the row that
+  // starts before offset + length, so consecutive ranges partition
+  // the rows exactly.
+  const char *begin = data;
+  const char *end   = data + size;
+  if (opts.offset > 0)
+    begin = range_cut(data, size, opts.offset);
+  if (opts.length >= 0)
+    end = range_cut(data, size, opts.offset + opts.length);
+
+  if (rows.stats)
+    rows.stats->bytes_read = end - begin;
+
+  long n_rows = opts.n_samples_hint, nnz = opts.nnz_hint;
+
+  if (opts.prescan && (n_rows < 0 || nnz < 0)) {
+    size_t counted_rows, counted_nnz;
+    count_rows_and_nnz(begin, end, counted_rows, counted_nnz);
+    if (n_rows < 0)
+      n_rows = counted_rows;
+    if (nnz < 0)
+      nnz = counted_nnz;
+  }
+  // Hints and pre-scan counts describe all rows in the range; with
+  // subsampling the real sizes are ~sample_rate of that, so exact
+  // reservation is off the table and we let the vectors grow.
+  if (n_rows >= 0 && nnz >= 0 && opts.sample_rate >= 1.0)
+    reserve_all(n_rows, nnz, rows);
+
+  if (opts.sample_rate < 1.0) {
+    RowSampler sampler(opts.sample_rate, opts.seed);
+    const char *p = begin;
+    while (p < end) {
+      const char *nl = (const char *)std::memchr(p, '\n', end - p);
+      const char *line_end = nl ? nl : end;
+      if (sampler.keep())
+        parse_line_checked(p, line_end, rows);
+      else
+        ++rows.line_no;
+      p = nl ? nl + 1 : end;
+    }
+  } else {
+    parse_buffer(begin, end, rows);
+  }
+  rows.finish();
+}
+
+template <typename D, typename I>
+void parse_file_compressed(char const *file_path,
+                           Compression compression,
+                           LoadOptions const &opts,
+                           Rows<D, I> &rows)
+{
+#ifndef HAVE_ZSTD
+  if (compression == COMPRESS_ZSTD)
+    throw std::runtime_error("zstd-compressed input, but zstd support "
+                             "was not compiled in");
+#endif
+
+  parse_producer_stream(
+#ifdef HAVE_ZSTD
+      compression == COMPRESS_ZSTD ? zstd_producer :
+#endif
+      gzip_producer,
+      file_path, opts, rows);
+}
+
+/*
+ * Parse entire file. Throws exception on failure.
+ */
+template <typename D, typename I>
+void parse_file(char const *file_path,
+                LoadOptions const &opts,
+                Rows<D, I> &rows)
+{
+  Compression compression = detect_compression(file_path);
+  if (compression != COMPRESS_NONE) {
+    if (opts.subset())
+      throw std::runtime_error("offset/length/sample_rate are not "
+                               "supported for compressed input");
+    parse_file_compressed(file_path, compression, opts, rows);
+    return;
+  }
+
+  // Cold-cache reads: keep a ring of O_DIRECT requests in flight
+  // instead of one synchronous read at a time. Subset loads keep the
+  // plain paths, same as read_ahead below.
+  if (opts.direct_io && !opts.subset()) {
+#ifdef HAVE_IO_URING
+    if (opts.n_samples_hint >= 0 && opts.nnz_hint >= 0)
+      reserve_all(opts.n_samples_hint, opts.nnz_hint, rows);
+    parse_producer_stream(uring_producer, file_path, opts, rows);
+    return;
+#else
+    throw std::runtime_error("direct_io requested, but io_uring support "
+                             "was not compiled in");
+#endif
+  }
+
+  // Overlapped read-ahead: a reader thread fills one block while this
+  // thread parses the previous one. Subset loads keep the plain paths,
+  // whose line-level bookkeeping the block pipeline does not carry.
+  if (opts.read_ahead && !opts.subset()) {
+    if (opts.n_samples_hint >= 0 && opts.nnz_hint >= 0)
+      reserve_all(opts.n_samples_hint, opts.nnz_hint, rows);
+    parse_producer_stream(file_producer, file_path, opts, rows);
+    return;
+  }
+
+#ifdef HAVE_MMAP
+  MappedFile map(file_path);
+  if (map.usable()) {
+    parse_memory(map.data(), map.size(), opts, rows);
+    return;
+  }
+#endif
+  parse_file_stream(file_path, opts, rows);
+}
+
+/*
+ * Per-chunk state for the parallel parser. Each worker parses its
+ * line-aligned [begin, end) slice of the mapping into its own set of
+ * vectors; indptr is chunk-relative and fixed up when the chunks are
+ * stitched back together.
+ */
+template <typename D, typename I>
+struct ParseChunk {
+  const char *begin, *end;
+  Rows<D, I> rows;
+  std::exception_ptr error;
+};
+
+template <typename D, typename I>
+static void parse_chunk(ParseChunk<D, I> &chunk, bool prescan)
+{
+  try {
+    if (prescan) {
+      size_t n_rows, nnz;
+      count_rows_and_nnz(chunk.begin, chunk.end, n_rows, nnz);
+      reserve_all(n_rows, nnz, chunk.rows);
+    }
+    parse_buffer(chunk.begin, chunk.end, chunk.rows);
+  } catch (...) {
+    chunk.error = std::current_exception();
+  }
+}
+
+/*
+ * Split an in-memory byte range among n_threads worker threads and
+ * stitch the per-chunk CSR fragments together.
+ */
+template <typename D, typename I>
+void parse_buffer_parallel(const char *base, const char *end,
+                           LoadOptions const &opts,
+                           Rows<D, I> &rows)
+{
+  unsigned n_threads = opts.n_threads;
+
+  // Per-line counters stay on the serial paths; the chunk workers
+  // run without a stats sink, but totals are still filled in.
+  if (rows.stats)
+    rows.stats->bytes_read = end - base;
+
+  // Nominal equal-sized byte ranges, each moved up to the first byte
+  // after the next newline so no line straddles two chunks.
+  std::vector<ParseChunk<D, I> > chunks(n_threads);
+  const char *begin = base;
+  for (unsigned t = 0; t < n_threads; ++t) {
+    chunks[t].rows.multilabel = rows.multilabel;
+    chunks[t].rows.filter = rows.filter;
+    const char *nominal = base + size_t(end - base) * (t + 1) / n_threads;
+    const char *nl = nominal < end
+      ? (const char *)std::memchr(nominal, '\n', end - nominal)
+      : 0;
+    chunks[t].begin = begin;
+    chunks[t].end   = nl ? nl + 1 : end;
+    begin = chunks[t].end;
+  }
+
+  // Quarantined line numbers are file-global, so each chunk starts
+  // its counter at the number of lines before it; the counting pass
+  // only runs in skip mode.
+  if (rows.skip_bad) {
+    size_t line_base = 0;
+    for (unsigned t = 0; t < n_threads; ++t) {
+      chunks[t].rows.skip_bad = true;
+      chunks[t].rows.line_no = line_base;
+      size_t chunk_rows, chunk_nnz;
+      count_rows_and_nnz(chunks[t].begin, chunks[t].end,
+                         chunk_rows, chunk_nnz);
+      line_base += chunk_rows;
+    }
+  }
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < n_threads; ++t)
+    workers.push_back(std::thread(parse_chunk<D, I>, std::ref(chunks[t]),
+                                  opts.prescan));
+  for (unsigned t = 0; t < n_threads; ++t)
+    workers[t].join();
+
+  for (unsigned t = 0; t < n_threads; ++t)
+    if (chunks[t].error)
+      std::rethrow_exception(chunks[t].error);
+
+  size_t n_rows = 0, nnz = 0;
+  bool any_qids = false;
+  for (unsigned t = 0; t < n_threads; ++t) {
+    n_rows += chunks[t].rows.n_rows();
+    nnz    += chunks[t].rows.data.size();
+    any_qids |= !chunks[t].rows.qids.empty();
+  }
+
+  // parse_line enforces all-or-nothing qids within a chunk; chunks
+  // must also agree among themselves.
+  if (any_qids)
+    for (unsigned t = 0; t < n_threads; ++t)
+      if (chunks[t].rows.qids.size() != chunks[t].rows.n_rows())
+        throw SyntaxError("qid present on some lines only");
+
+  reserve_all(n_rows, nnz, rows);
+
+  for (unsigned t = 0; t < n_threads; ++t) {
+    Rows<D, I> &chunk = chunks[t].rows;
+    I row_offset = rows.data.size();
+    I label_offset = rows.labels.size();
+
+    for (size_t i = 0; i < chunk.indptr.size(); ++i)
+      rows.indptr.push_back(chunk.indptr[i] + row_offset);
+    for (size_t i = 0; i < chunk.label_indptr.size(); ++i)
+      rows.label_indptr.push_back(chunk.label_indptr[i] + label_offset);
+    rows.bad_lines.insert(rows.bad_lines.end(),
+                          chunk.bad_lines.begin(),
+                          chunk.bad_lines.end());
+    rows.data.insert(rows.data.end(),
+                     chunk.data.begin(), chunk.data.end());
+    rows.indices.insert(rows.indices.end(),
+                        chunk.indices.begin(), chunk.indices.end());
+    rows.labels.insert(rows.labels.end(),
+                       chunk.labels.begin(), chunk.labels.end());
+    rows.qids.insert(rows.qids.end(),
+                     chunk.qids.begin(), chunk.qids.end());
+    rows.min_index = std::min(rows.min_index, chunk.min_index);
+    rows.max_index = std::max(rows.max_index, chunk.max_index);
+  }
+  rows.finish();
+}
+
+/*
+ * Parse entire file with n_threads worker threads, each taking an equal
+ * slice of the memory mapping (or, with direct_io, of a queue-depth
+ * O_DIRECT read of the file), then stitch the per-chunk CSR fragments
+ * together. Falls back to the serial parser when the file cannot be
+ * mapped or is too small to be worth splitting.
+ * Throws exception on failure.
+ */
+template <typename D, typename I>
+void parse_file_parallel(char const *file_path,
+                         LoadOptions const &opts,
+                         Rows<D, I> &rows)
+{
+  // Compressed streams can't be split by byte range; parse_file gives
+  // them the overlapped decompress-and-parse pipeline instead. Subset
+  // loads (byte range or subsampling) also go through the serial
+  // parser: they already read less, and a per-chunk RNG would make the
+  // sample depend on the thread count.
+  if (detect_compression(file_path) != COMPRESS_NONE || opts.subset()) {
+    parse_file(file_path, opts, rows);
+    return;
+  }
+
+  unsigned n_threads = opts.n_threads;
+
+#ifdef HAVE_IO_URING
+  // A cold mapping faults pages in one read at a time; when direct_io
+  // is requested, pull the whole file in through the ring first and
+  // chunk the in-memory copy.
+  if (opts.direct_io && n_threads >= 2) {
+    std::vector<char> arena;
+    if (uring_read_file(file_path, opts.buffer_size, arena)
+        && arena.size() >= n_threads * 4096) {
+      parse_buffer_parallel(&arena[0], &arena[0] + arena.size(),
+                            opts, rows);
+      return;
+    }
+  }
+#else
+  // parse_file owns the "not compiled in" diagnostic for direct_io.
+  if (opts.direct_io) {
+    parse_file(file_path, opts, rows);
+    return;
+  }
+#endif
+
+#ifdef HAVE_MMAP
+  MappedFile map(file_path);
+  if (map.data() && n_threads >= 2 && map.size() >= n_threads * 4096) {
+    parse_buffer_parallel(map.data(), map.data() + map.size(), opts, rows);
+    return;
+  }
+#endif  // HAVE_MMAP
+  parse_file(file_path, opts, rows);
+}
+
+
+/*
+ * Incremental reader backing load_svmlight_chunks. Keeps the mapping
+ * (or the stream, on the fallback path) open between calls and parses a
+ * bounded number of rows per call into its own vectors, which to_csr
+ * then steals; the sizes of the previous chunk are used to reserve the
+ * next one, so steady-state growth reallocation is avoided.
+ *
+ * The non-template base is what the capsule holds, so one handle type
+ * serves every dtype instantiation.
+ */
+class ChunkReaderBase {
+public:
+  virtual ~ChunkReaderBase() {}
+
+  // Parse up to chunk_rows rows (comment lines don't count) without
+  // touching Python state; returns the number parsed, 0 at end of file.
+  virtual size_t next_chunk(size_t chunk_rows) = 0;
+
+  // Build the result tuple for the chunk just parsed, stealing the
+  // internal vectors. Requires the GIL.
+  virtual PyObject *take_csr() = 0;
+};
+
+template <typename D, typename I>
+class ChunkReader : public ChunkReaderBase {
+public:
+  ChunkReader(char const *file_path, LoadOptions const &opts)
+    : zero_based_(opts.zero_based), last_rows_(0), last_nnz_(0)
+  {
+    if (detect_compression(file_path) != COMPRESS_NONE)
+      throw std::runtime_error("compressed input is not supported by "
+                               "the chunk reader");
+
+#ifdef HAVE_MMAP
+    map_ = new MappedFile(file_path);
+    if (map_->usable()) {
+      pos_ = map_->data();
+      end_ = map_->data() + map_->size();
+      return;
+    }
+    delete map_;
+    map_ = 0;
+#endif
+    buffer_.resize(opts.buffer_size);
+    stream_.exceptions(std::ios::badbit);
+    stream_.rdbuf()->pubsetbuf(&buffer_[0], opts.buffer_size);
+    stream_.open(file_path);
+    if (!stream_)
+      throw std::ios_base::failure("File doesn't exist!");
+  }
+
+  ~ChunkReader()
+  {
+#ifdef HAVE_MMAP
+    delete map_;
+#endif
+  }
+
+  size_t next_chunk(size_t chunk_rows)
+  {
+    reserve_all(last_rows_, last_nnz_, rows);
+    // to_csr stole the vectors, but min_index survives; auto detection
+    // is per chunk, so start it afresh.
+    rows.min_index = std::numeric_limits<I>::max();
+    rows.max_index = -1;
+
+#ifdef HAVE_MMAP
+    if (map_) {
+      while (rows.labels.size() < chunk_rows && pos_ < end_) {
+        const char *nl = (const char *)std::memchr(pos_, '\n', end_ - pos_);
+        const char *line_end = nl ? nl : end_;
+        parse_line(pos_, line_end, rows);
+        pos_ = nl ? nl + 1 : end_;
+      }
+    } else
+#endif
+    {
+      std::string line;
+      while (rows.labels.size() < chunk_rows && std::getline(stream_, line))
+        parse_line(line, rows);
+    }
+
+    if (rows.labels.size() == 0)
+      return 0;
+
+    rows.indptr.push_back(rows.data.size());
+    apply_zero_based(rows, zero_based_);
+    last_rows_ = rows.labels.size();
+    last_nnz_ = rows.data.size();
+    return last_rows_;
+  }
+
+  PyObject *take_csr()
+  {
+    return to_csr(rows.data, rows.indices, rows.indptr, rows.labels,
+                  rows.qids, rows.label_indptr);
+  }
+
+  Rows<D, I> rows;
+
+private:
+  ChunkReader(ChunkReader const &);
+  ChunkReader &operator=(ChunkReader const &);
+
+#ifdef HAVE_MMAP
+  MappedFile *map_;
+  const char *pos_, *end_;
+#endif
+  std::ifstream stream_;
+  std::vector<char> buffer_;
+  int zero_based_;
+  size_t last_rows_, last_nnz_;
+};
+
+static const char CHUNK_READER_CAPSULE[] = "svmlight_loader.ChunkReader";
+
+extern "C" {
+static void destroy_chunk_reader(PyObject *capsule)
+{
+  delete (ChunkReaderBase *)PyCapsule_GetPointer(capsule,
+                                                 CHUNK_READER_CAPSULE);
+}
+}
+
+/*
+ * Reusable builder for incremental loading: append_file parses a delta
+ * file's rows straight onto the ends of the accumulated CSR vectors,
+ * so ingesting a delta costs the delta, not a reload-and-vstack of the
+ * whole matrix. take_csr snapshots the accumulation either by copy
+ * (the builder keeps growing) or by stealing the vectors outright (no
+ * copy; the builder starts over empty).
+ *
+ * Same capsule arrangement as ChunkReaderBase: the non-template base
+ * is what the handle holds.
+ */
+class CSRBuilderBase {
+public:
+  virtual ~CSRBuilderBase() {}
+
+  // Parse one more file onto the accumulation; returns the number of
+  // rows it added. Touches no Python state.
+  virtual size_t append_file(char const *file_path) = 0;
+
+  // Build the result tuple for everything appended so far. Requires
+  // the GIL.
+  virtual PyObject *take_csr(bool copy) = 0;
+};
+
+template <typename D, typename I>
+class CSRBuilder : public CSRBuilderBase {
+public:
+  explicit CSRBuilder(LoadOptions const &opts)
+    : opts_(opts)
+  {
+    rows_.multilabel = opts_.multilabel;
+    rows_.skip_bad = opts_.skip_bad;
+    if (opts_.filter.active())
+      rows_.filter = &opts_.filter;
+  }
+
+  size_t append_file(char const *file_path)
+  {
+    size_t before = rows_.n_rows();
+    if (opts_.n_threads > 1)
+      parse_file_parallel(file_path, opts_, rows_);
+    else
+      parse_file(file_path, opts_, rows_);
+    // parse_file closed the ragged arrays; reopen them so the next
+    // append continues the same row sequence.
+    rows_.indptr.pop_back();
+    if (rows_.multilabel)
+      rows_.label_indptr.pop_back();
+    return rows_.n_rows() - before;
+  }
+
+  PyObject *take_csr(bool copy)
+  {
+    if (copy) {
+      // The zero_based shift applies to the snapshot only; the
+      // accumulated indices stay as parsed so later snapshots don't
+      // shift them twice.
+      Rows<D, I> snapshot(rows_);
+      snapshot.finish();
+      apply_zero_based(snapshot, opts_.zero_based);
+      return to_csr(snapshot.data, snapshot.indices, snapshot.indptr,
+                    snapshot.labels, snapshot.qids,
+                    snapshot.label_indptr);
+    }
+
+    rows_.finish();
+    apply_zero_based(rows_, opts_.zero_based);
+    PyObject *result = to_csr(rows_.data, rows_.indices, rows_.indptr,
+                              rows_.labels, rows_.qids,
+                              rows_.label_indptr);
+    // to_csr stole the vectors; reset the rest of the parse state so
+    // the builder starts over cleanly.
+    rows_.min_index = std::numeric_limits<I>::max();
+    rows_.max_index = -1;
+    rows_.line_no = 0;
+    rows_.bad_lines.clear();
+    return result;
+  }
+
+  Rows<D, I> const &rows() const { return rows_; }
+
+private:
+  CSRBuilder(CSRBuilder const &);
+  CSRBuilder &operator=(CSRBuilder const &);
+
+  LoadOptions opts_;
+  Rows<D, I> rows_;
+};
+
+static const char CSR_BUILDER_CAPSULE[] = "svmlight_loader.CSRBuilder";
+
+extern "C" {
+static void destroy_csr_builder(PyObject *capsule)
+{
+  delete (CSRBuilderBase *)PyCapsule_GetPointer(capsule,
+                                                CSR_BUILDER_CAPSULE);
+}
+}
+
+/*
+ * Output dtype selectors passed in from Python; also used to pick a
+ * ChunkReader instantiation.
+ */
+enum { VALUE_F64 = 0, VALUE_F32 = 1 };
+enum { INDEX_I32 = 0, INDEX_I64 = 1 };
+
+
+template <typename D, typename I>
+static PyObject *build_load_result(Rows<D, I> &rows,
+                                   LoadOptions const &opts,
+                                   LoadStats &stats,
+                                   std::chrono::steady_clock::time_point
+                                       parse_start);
+
+/*
+ * Load a file end to end with a given value/index type combination:
+ * check the cache, parse, optionally write the cache, build the tuple.
+ */
+template <typename D, typename I>
+static PyObject *do_load(char const *file_path, LoadOptions const &opts,
+                         bool use_cache)
+{
+  std::string cache_path = std::string(file_path) + ".cache";
+
+  // The cache stores exactly one label per row and always the whole
+  // file: ragged multilabel results and subset loads (byte range or
+  // subsampling) always reparse.
+  // The point of a stats run is to measure the real parse, so it
+  // never short-circuits through the cache (it may still write one).
+  // A skip_bad parse may quarantine rows; caching (or consuming a
+  // cache for) such a load would let an on_error="skip" result leak
+  // into a later on_error="raise" call as a silently truncated matrix.
+  use_cache = use_cache && !opts.multilabel && !opts.subset()
+      && !opts.filter.active() && !opts.return_stats && !opts.skip_bad
+      && opts.format == FORMAT_CSR;
+
+#ifdef HAVE_MMAP
+  if (use_cache && cache_is_fresh(file_path, cache_path)) {
+    PyObject *cached = load_cache<D, I>(cache_path, opts.zero_based);
+    if (cached)
+      return cached;
+    // Unreadable, malformed or differently-typed cache: reparse.
+  }
+#endif
+
+  Rows<D, I> rows;
+  rows.multilabel = opts.multilabel;
+  rows.skip_bad = opts.skip_bad;
+  if (opts.filter.active())
+    rows.filter = &opts.filter;
+
+  LoadStats stats;
+  if (opts.return_stats)
+    rows.stats = &stats;
+  std::chrono::steady_clock::time_point parse_start =
+      std::chrono::steady_clock::now();
+
+  // The parser only touches C++ state, so release the GIL while it runs.
+  std::exception_ptr error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (opts.n_threads > 1)
+      parse_file_parallel(file_path, opts, rows);
+    else
+      parse_file(file_path, opts, rows);
+    // Shift before writing the cache so cached indices are final and a
+    // cache hit needs no further pass over them.
+    apply_zero_based(rows, opts.zero_based);
+    if (use_cache)
+      write_cache(cache_path, rows.data, rows.indices, rows.indptr,
+                  rows.labels, rows.qids, opts.zero_based);
+    if (opts.format == FORMAT_CSC)
+      transpose_to_csc(rows, opts.n_cols);
+    else if (opts.format == FORMAT_COO)
+      expand_to_coo(rows);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  Py_END_ALLOW_THREADS
+  if (error)
+    std::rethrow_exception(error);
+
+  return build_load_result(rows, opts, stats, parse_start);
+}
+
+/*
+ * Turn parsed rows into the Python result (plus the stats dict when
+ * requested); shared tail of the file and buffer loaders.
+ */
+template <typename D, typename I>
+static PyObject *build_load_result(Rows<D, I> &rows,
+                                   LoadOptions const &opts,
+                                   LoadStats &stats,
+                                   std::chrono::steady_clock::time_point
+                                       parse_start)
+{
+  if (opts.return_stats) {
+    stats.parse_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - parse_start).count();
+    stats.n_rows = rows.n_rows();
+    stats.nnz = rows.data.size();
+    rows.stats = NULL;
+  }
+
+  if (!rows.bad_lines.empty()
+      && PyErr_WarnFormat(PyExc_RuntimeWarning, 1,
+                          "skipped %zu malformed line(s)",
+                          rows.bad_lines.size()) < 0)
+    return 0;
+
+  PyObject *result;
+#ifdef HAVE_MMAP
+  if (opts.hugepages || opts.numa_policy != NUMA_NONE)
+    result = to_csr_arena(rows.data, rows.indices, rows.indptr,
+                          rows.labels, rows.qids, rows.label_indptr,
+                          opts.hugepages, opts.numa_policy,
+                          opts.numa_node);
+  else
+#endif
+    result = to_csr(rows.data, rows.indices, rows.indptr, rows.labels,
+                    rows.qids, rows.label_indptr);
+
+  if (!result || !opts.return_stats)
+    return result;
+
+  PyObject *bad_lines = PyList_New(rows.bad_lines.size());
+  if (!bad_lines) {
+    Py_DECREF(result);
+    return 0;
+  }
+  for (size_t i = 0; i < rows.bad_lines.size(); ++i)
+    PyList_SET_ITEM(bad_lines, i, PyLong_FromSize_t(rows.bad_lines[i]));
+
+  // Class distribution: None when the histogram overflowed (regression
+  // targets), otherwise {label: count}.
+  PyObject *label_counts;
+  if (stats.label_hist.overflow) {
+    label_counts = Py_None;
+    Py_INCREF(label_counts);
+  } else {
+    label_counts = PyDict_New();
+    if (!label_counts) {
+      Py_DECREF(bad_lines);
+      Py_DECREF(result);
+      return 0;
+    }
+    for (size_t i = 0; i < stats.label_hist.keys.size(); ++i) {
+      if (!stats.label_hist.used[i])
+        continue;
+      PyObject *key = PyFloat_FromDouble(stats.label_hist.keys[i]);
+      PyObject *count =
+        PyLong_FromUnsignedLongLong(stats.label_hist.counts[i]);
+      int rc = key && count ? PyDict_SetItem(label_counts, key, count) : -1;
+      Py_XDECREF(key);
+      Py_XDECREF(count);
+      if (rc < 0) {
+        Py_DECREF(label_counts);
+        Py_DECREF(bad_lines);
+        Py_DECREF(result);
+        return 0;
+      }
+    }
+  }
+
+  // {nnz: n_rows with that many nonzeros}; the NNZ_HIST_CAP bucket
+  // counts rows at or past the cap.
+  PyObject *nnz_per_row = PyDict_New();
+  if (!nnz_per_row) {
+    Py_DECREF(label_counts);
+    Py_DECREF(bad_lines);
+    Py_DECREF(result);
+    return 0;
+  }
+  for (size_t i = 0; i < stats.nnz_hist.size(); ++i) {
+    if (!stats.nnz_hist[i])
+      continue;
+    PyObject *key = PyLong_FromSize_t(i);
+    PyObject *count = PyLong_FromUnsignedLongLong(stats.nnz_hist[i]);
+    int rc = key && count ? PyDict_SetItem(nnz_per_row, key, count) : -1;
+    Py_XDECREF(key);
+    Py_XDECREF(count);
+    if (rc < 0) {
+      Py_DECREF(nnz_per_row);
+      Py_DECREF(label_counts);
+      Py_DECREF(bad_lines);
+      Py_DECREF(result);
+      return 0;
+    }
+  }
+
+  return Py_BuildValue(
+      "N{s:K,s:K,s:K,s:d,s:d,s:d,s:K,s:K,s:K,s:K,s:N,s:d,s:d,s:N,s:N}",
+      result,
+      "bytes_read", stats.bytes_read,
+      "rows", stats.n_rows,
+      "nnz", stats.nnz,
+      "parse_seconds", stats.parse_seconds,
+      "read_seconds", stats.read_seconds,
+      "rows_per_sec", stats.parse_seconds > 0.0
+          ? stats.n_rows / stats.parse_seconds : 0.0,
+      "realloc_count", stats.realloc_count,
+      "realloc_bytes", stats.realloc_bytes,
+      "recovered_lines", stats.recovered_lines,
+      "skipped_lines", (unsigned long long)rows.bad_lines.size(),
+      "bad_lines", bad_lines,
+      "label_min", stats.label_min,
+      "label_max", stats.label_max,
+      "label_counts", label_counts,
+      "nnz_per_row", nnz_per_row);
+}
+
+/*
+ * Load from an in-memory buffer -- the borrowed bytes of a
+ * buffer-protocol object (bytes, memoryview, mmap) -- with the same
+ * pipeline as do_load minus the cache, which is keyed by file path.
+ * The bytes are parsed in place; nothing is copied or spooled.
+ */
+template <typename D, typename I>
+static PyObject *do_load_buffer(char const *data, size_t size,
+                                LoadOptions const &opts)
+{
+  // Compressed payloads would need a decompression copy anyway; keep
+  // the zero-copy contract and point the caller at the file loader.
+  if (size >= 2 && (unsigned char)data[0] == 0x1f
+      && (unsigned char)data[1] == 0x8b)
+    throw std::runtime_error("compressed buffers are not supported; "
+                             "decompress first or pass a file path");
+  if (size >= 4 && (unsigned char)data[0] == 0x28
+      && (unsigned char)data[1] == 0xb5
+      && (unsigned char)data[2] == 0x2f
+      && (unsigned char)data[3] == 0xfd)
+    throw std::runtime_error("compressed buffers are not supported; "
+                             "decompress first or pass a file path");
+
+  Rows<D, I> rows;
+  rows.multilabel = opts.multilabel;
+  rows.skip_bad = opts.skip_bad;
+  if (opts.filter.active())
+    rows.filter = &opts.filter;
+
+  LoadStats stats;
+  if (opts.return_stats)
+    rows.stats = &stats;
+  std::chrono::steady_clock::time_point parse_start =
+      std::chrono::steady_clock::now();
+
+  // The buffer is pinned by the caller's Py_buffer view for the whole
+  // call, so the GIL can be dropped here just like for files.
+  std::exception_ptr error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    if (opts.n_threads > 1 && !opts.subset()
+        && size >= opts.n_threads * (size_t)4096)
+      parse_buffer_parallel(data, data + size, opts, rows);
+    else
+      parse_memory(data, size, opts, rows);
+    apply_zero_based(rows, opts.zero_based);
+    if (opts.format == FORMAT_CSC)
+      transpose_to_csc(rows, opts.n_cols);
+    else if (opts.format == FORMAT_COO)
+      expand_to_coo(rows);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  Py_END_ALLOW_THREADS
+  if (error)
+    std::rethrow_exception(error);
+
+  return build_load_result(rows, opts, stats, parse_start);
+}
+
+static const char load_svmlight_file_doc[] =
+  "Load svmlight data from a file path or a buffer-protocol object\n"
+  "(bytes, memoryview, mmap; parsed in place) and return a CSR.";
+
+extern "C" {
+static PyObject *load_svmlight_file(PyObject *self, PyObject *args)
+{
+  try {
+    // Read function arguments.
+    PyObject *source;
+    int buffer_mb;
+    int n_threads = 1;
+    int prescan = 0;
+    long n_samples_hint = -1;
+    long nnz_hint = -1;
+    int use_cache = 0;
+    int value_dtype = VALUE_F64;
+    int index_dtype = INDEX_I32;
+    int zero_based = ZERO_BASED_AUTO;
+    int hugepages = 0;
+    int multilabel = 0;
+    long offset = 0;
+    long length = -1;
+    double sample_rate = 1.0;
+    long seed = 0;
+    long max_feature = -1;
+    PyObject *feature_subset = 0;
+    int read_ahead = 0;
+    int return_stats = 0;
+    int on_error = 0;
+    int numa_policy = 0;
+    long numa_node = -1;
+    int format = FORMAT_CSR;
+    long n_cols = -1;
+    int direct_io = 0;
+
+    if (!PyArg_ParseTuple(args, "Oi|iilliiiiiilldllOiiiilili", &source,
+                          &buffer_mb,
+                          &n_threads, &prescan, &n_samples_hint, &nnz_hint,
+                          &use_cache, &value_dtype, &index_dtype,
+                          &zero_based, &hugepages, &multilabel,
+                          &offset, &length, &sample_rate, &seed,
+                          &max_feature, &feature_subset, &read_ahead,
+                          &return_stats, &on_error, &numa_policy,
+                          &numa_node, &format, &n_cols, &direct_io))
+      return 0;
+
+    if (sample_rate <= 0.0 || sample_rate > 1.0) {
+      PyErr_SetString(PyExc_ValueError,
+                      "sample_rate must be in (0, 1]");
+      return 0;
+    }
+    if (offset < 0) {
+      PyErr_SetString(PyExc_ValueError, "offset must be non-negative");
+      return 0;
+    }
+
+    buffer_mb = std::max(buffer_mb, 1);
+
+    if (n_threads < 1)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    LoadOptions opts;
+    opts.buffer_size = buffer_mb * 1024 * 1024;
+    opts.n_threads = n_threads;
+    opts.prescan = prescan != 0;
+    opts.n_samples_hint = n_samples_hint;
+    opts.nnz_hint = nnz_hint;
+    opts.zero_based = zero_based;
+    opts.hugepages = hugepages != 0;
+    opts.multilabel = multilabel != 0;
+    opts.offset = offset;
+    opts.length = length;
+    opts.sample_rate = sample_rate;
+    opts.seed = seed;
+    opts.read_ahead = read_ahead != 0;
+    opts.direct_io = direct_io != 0;
+    opts.return_stats = return_stats != 0;
+    opts.skip_bad = on_error != 0;
+    opts.numa_policy = numa_policy;
+    opts.numa_node = numa_node;
+    opts.format = format;
+    opts.n_cols = n_cols;
+    opts.filter.max_feature = max_feature;
+
+    if (feature_subset && feature_subset != Py_None) {
+      PyObject *seq = PySequence_Fast(feature_subset,
+                                      "feature_subset must be a sequence");
+      if (!seq)
+        return 0;
+      Py_ssize_t n_ids = PySequence_Fast_GET_SIZE(seq);
+      for (Py_ssize_t i = 0; i < n_ids; ++i) {
+        Py_ssize_t id = PyNumber_AsSsize_t(PySequence_Fast_GET_ITEM(seq, i),
+                                           PyExc_OverflowError);
+        if (id == -1 && PyErr_Occurred()) {
+          Py_DECREF(seq);
+          return 0;
+        }
+        if (id < 0) {
+          Py_DECREF(seq);
+          PyErr_SetString(PyExc_ValueError,
+                          "feature_subset ids must be non-negative");
+          return 0;
+        }
+        opts.filter.set(id);
+      }
+      Py_DECREF(seq);
+    }
+
+    // Text strings are file paths; anything else must export the
+    // buffer protocol and is parsed in place.
+    char const *file_path = 0;
+    if (
+#if PY_MAJOR_VERSION < 3
+        PyString_Check(source) ||
+#endif
+        PyUnicode_Check(source)) {
+      if (!PyArg_Parse(source, "s", &file_path))
+        return 0;
+    }
+
+    // One instantiation of the whole parse pipeline per type pair, so a
+    // float32 load works in float32 end to end: no post-parse conversion
+    // pass and no transient double-sized copy.
+    if (file_path) {
+      if (value_dtype == VALUE_F32 && index_dtype == INDEX_I64)
+        return do_load<float, long long>(file_path, opts, use_cache != 0);
+      else if (value_dtype == VALUE_F32)
+        return do_load<float, int>(file_path, opts, use_cache != 0);
+      else if (index_dtype == INDEX_I64)
+        return do_load<double, long long>(file_path, opts, use_cache != 0);
+      else
+        return do_load<double, int>(file_path, opts, use_cache != 0);
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(source, &view, PyBUF_SIMPLE) < 0)
+      return 0;
+    char const *data = (char const *)view.buf;
+    size_t size = view.len;
+
+    PyObject *result;
+    try {
+      if (value_dtype == VALUE_F32 && index_dtype == INDEX_I64)
+        result = do_load_buffer<float, long long>(data, size, opts);
+      else if (value_dtype == VALUE_F32)
+        result = do_load_buffer<float, int>(data, size, opts);
+      else if (index_dtype == INDEX_I64)
+        result = do_load_buffer<double, long long>(data, size, opts);
+      else
+        result = do_load_buffer<double, int>(data, size, opts);
+    } catch (...) {
+      PyBuffer_Release(&view);
+      throw;
+    }
+    PyBuffer_Release(&view);
+    return result;
+
+  } catch (SyntaxError const &e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::ios_base::failure const &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+/*
+ * Multi-file worker: each of n_workers threads takes every n_workers-th
+ * file, so files parse concurrently without a work queue. Failures are
+ * recorded per file and rethrown in path order once all workers finish.
+ */
+template <typename D, typename I>
+static void parse_files_worker(std::vector<std::string> const *paths,
+                               LoadOptions const *opts,
+                               std::vector<Rows<D, I> > *files,
+                               std::vector<std::exception_ptr> *errors,
+                               unsigned first, unsigned stride)
+{
+  for (size_t i = first; i < paths->size(); i += stride) {
+    try {
+      parse_file((*paths)[i].c_str(), *opts, (*files)[i]);
+    } catch (...) {
+      (*errors)[i] = std::current_exception();
+    }
+  }
+}
+
+/*
+ * Load several files with one thread pool pass, sharing the zero_based
+ * decision and the inferred width across all of them: "auto" shifts
+ * either every file or none, and the returned n_features covers the
+ * largest feature index seen anywhere. Returns ([csr_tuple, ...],
+ * n_features).
+ */
+template <typename D, typename I>
+static PyObject *do_load_files(std::vector<std::string> const &paths,
+                               LoadOptions const &opts)
+{
+  size_t n_files = paths.size();
+  std::vector<Rows<D, I> > files(n_files);
+  std::vector<std::exception_ptr> errors(n_files);
+  long n_features = 0;
+
+  for (size_t i = 0; i < n_files; ++i) {
+    files[i].multilabel = opts.multilabel;
+    if (opts.filter.active())
+      files[i].filter = &opts.filter;
+  }
+
+  std::exception_ptr error;
+  Py_BEGIN_ALLOW_THREADS
+  try {
+    unsigned n_workers = opts.n_threads;
+    if (n_workers > n_files)
+      n_workers = n_files;
+
+    if (n_workers >= 2) {
+      std::vector<std::thread> workers;
+      for (unsigned t = 0; t < n_workers; ++t)
+        workers.push_back(std::thread(parse_files_worker<D, I>,
+                                      &paths, &opts, &files, &errors,
+                                      t, n_workers));
+      for (unsigned t = 0; t < n_workers; ++t)
+        workers[t].join();
+    } else {
+      parse_files_worker<D, I>(&paths, &opts, &files, &errors, 0, 1);
+    }
+
+    for (size_t i = 0; i < n_files; ++i)
+      if (errors[i])
+        std::rethrow_exception(errors[i]);
+
+    // One zero_based decision for the whole set: a shard that happens
+    // to lack a zero index must not end up shifted against the others.
+    I global_min = std::numeric_limits<I>::max();
+    I global_max = -1;
+    for (size_t i = 0; i < n_files; ++i) {
+      global_min = std::min(global_min, files[i].min_index);
+      global_max = std::max(global_max, files[i].max_index);
+    }
+
+    int resolved = opts.zero_based;
+    if (resolved == ZERO_BASED_AUTO)
+      resolved = (global_max >= 0 && global_min > 0)
+               ? ZERO_BASED_FALSE : ZERO_BASED_TRUE;
+    for (size_t i = 0; i < n_files; ++i)
+      apply_zero_based(files[i], resolved);
+
+    if (global_max >= 0)
+      n_features = global_max + (resolved == ZERO_BASED_FALSE ? 0 : 1);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  Py_END_ALLOW_THREADS
+  if (error)
+    std::rethrow_exception(error);
+
+  PyObject *list = PyList_New(n_files);
+  if (!list)
+    throw std::bad_alloc();
+
+  try {
+    for (size_t i = 0; i < n_files; ++i) {
+      Rows<D, I> &f = files[i];
+#ifdef HAVE_MMAP
+      if (opts.hugepages || opts.numa_policy != NUMA_NONE) {
+        PyList_SET_ITEM(list, i, to_csr_arena(f.data, f.indices, f.indptr,
+                                              f.labels, f.qids,
+                                              f.label_indptr,
+                                              opts.hugepages,
+                                              opts.numa_policy,
+                                              opts.numa_node));
+        continue;
+      }
+#endif
+      PyList_SET_ITEM(list, i, to_csr(f.data, f.indices, f.indptr,
+                                      f.labels, f.qids, f.label_indptr));
+    }
+  } catch (std::exception const &e) {
+    Py_DECREF(list);
+    throw;
+  }
+
+  return Py_BuildValue("Nl", list, n_features);
+}
+
+static const char load_svmlight_files_doc[] =
+  "Load several svmlight files concurrently; returns a list of CSR\n"
+  "tuples and the jointly inferred n_features.";
+
+extern "C" {
+static PyObject *load_svmlight_files(PyObject *self, PyObject *args)
+{
+  try {
+    PyObject *path_seq;
+    int buffer_mb;
+    int n_threads = 0;
+    int value_dtype = VALUE_F64;
+    int index_dtype = INDEX_I32;
+    int zero_based = ZERO_BASED_AUTO;
+    int hugepages = 0;
+    int multilabel = 0;
+
+    if (!PyArg_ParseTuple(args, "Oi|iiiiii", &path_seq, &buffer_mb,
+                          &n_threads, &value_dtype, &index_dtype,
+                          &zero_based, &hugepages, &multilabel))
+      return 0;
+
+    std::vector<std::string> paths;
+    PyObject *seq = PySequence_Fast(path_seq, "expected a list of paths");
+    if (!seq)
+      return 0;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); ++i) {
+      char const *path;
+      if (!PyArg_Parse(PySequence_Fast_GET_ITEM(seq, i), "s", &path)) {
+        Py_DECREF(seq);
+        return 0;
+      }
+      paths.push_back(path);
+    }
+    Py_DECREF(seq);
+
+    // Default to one worker per core; the pool is capped at one worker
+    // per file inside do_load_files.
+    if (n_threads < 1)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    LoadOptions opts;
+    opts.buffer_size = std::max(buffer_mb, 1) * 1024 * 1024;
+    opts.n_threads = n_threads;
+    opts.zero_based = zero_based;
+    opts.hugepages = hugepages != 0;
+    opts.multilabel = multilabel != 0;
+
+    if (value_dtype == VALUE_F32 && index_dtype == INDEX_I64)
+      return do_load_files<float, long long>(paths, opts);
+    else if (value_dtype == VALUE_F32)
+      return do_load_files<float, int>(paths, opts);
+    else if (index_dtype == INDEX_I64)
+      return do_load_files<double, long long>(paths, opts);
+    else
+      return do_load_files<double, int>(paths, opts);
+
+  } catch (SyntaxError const &e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::ios_base::failure const &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+static const char open_chunk_reader_doc[] =
+  "Open an incremental svmlight reader; returns an opaque handle.";
+
+extern "C" {
+static PyObject *open_chunk_reader(PyObject *self, PyObject *args)
+{
+  try {
+    char const *file_path;
+    int buffer_mb;
+    int value_dtype = VALUE_F64;
+    int index_dtype = INDEX_I32;
+    int zero_based = ZERO_BASED_AUTO;
+
+    if (!PyArg_ParseTuple(args, "si|iii", &file_path, &buffer_mb,
+                          &value_dtype, &index_dtype, &zero_based))
+      return 0;
+
+    LoadOptions opts;
+    opts.buffer_size = std::max(buffer_mb, 1) * 1024 * 1024;
+    opts.zero_based = zero_based;
+
+    ChunkReaderBase *reader;
+    if (value_dtype == VALUE_F32 && index_dtype == INDEX_I64)
+      reader = new ChunkReader<float, long long>(file_path, opts);
+    else if (value_dtype == VALUE_F32)
+      reader = new ChunkReader<float, int>(file_path, opts);
+    else if (index_dtype == INDEX_I64)
+      reader = new ChunkReader<double, long long>(file_path, opts);
+    else
+      reader = new ChunkReader<double, int>(file_path, opts);
+
+    PyObject *capsule = PyCapsule_New(reader, CHUNK_READER_CAPSULE,
+                                      destroy_chunk_reader);
+    if (!capsule)
+      delete reader;
+    return capsule;
+
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::ios_base::failure const &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+static const char read_chunk_doc[] =
+  "Read the next chunk_rows rows from an incremental reader; returns a\n"
+  "CSR tuple, or None once the file is exhausted.";
+
+extern "C" {
+static PyObject *read_chunk(PyObject *self, PyObject *args)
+{
+  try {
+    PyObject *capsule;
+    long chunk_rows;
+
+    if (!PyArg_ParseTuple(args, "Ol", &capsule, &chunk_rows))
+      return 0;
+
+    ChunkReaderBase *reader =
+      (ChunkReaderBase *)PyCapsule_GetPointer(capsule,
+                                              CHUNK_READER_CAPSULE);
+    if (!reader)
+      return 0;
+
+    if (chunk_rows < 1) {
+      PyErr_SetString(PyExc_ValueError, "chunk_rows must be positive");
+      return 0;
+    }
+
+    size_t n_rows = 0;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+      n_rows = reader->next_chunk(chunk_rows);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (error)
+      std::rethrow_exception(error);
+
+    if (n_rows == 0)
+      Py_RETURN_NONE;
+
+    return reader->take_csr();
+
+  } catch (SyntaxError const &e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::ios_base::failure const &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+static const char csr_builder_new_doc[] =
+  "Create an incremental CSR builder; returns an opaque handle.";
+
+extern "C" {
+static PyObject *csr_builder_new(PyObject *self, PyObject *args)
+{
+  try {
+    int buffer_mb = 40;
+    int n_threads = 1;
+    int value_dtype = VALUE_F64;
+    int index_dtype = INDEX_I32;
+    int zero_based = ZERO_BASED_AUTO;
+    int multilabel = 0;
+    int on_error = 0;
+
+    if (!PyArg_ParseTuple(args, "|iiiiiii", &buffer_mb, &n_threads,
+                          &value_dtype, &index_dtype, &zero_based,
+                          &multilabel, &on_error))
+      return 0;
+
+    LoadOptions opts;
+    opts.buffer_size = std::max(buffer_mb, 1) * 1024 * 1024;
+    opts.n_threads = n_threads < 1
+      ? std::max(1u, std::thread::hardware_concurrency())
+      : (unsigned)n_threads;
+    opts.zero_based = zero_based;
+    opts.multilabel = multilabel != 0;
+    opts.skip_bad = on_error != 0;
+
+    CSRBuilderBase *builder;
+    if (value_dtype == VALUE_F32 && index_dtype == INDEX_I64)
+      builder = new CSRBuilder<float, long long>(opts);
+    else if (value_dtype == VALUE_F32)
+      builder = new CSRBuilder<float, int>(opts);
+    else if (index_dtype == INDEX_I64)
+      builder = new CSRBuilder<double, long long>(opts);
+    else
+      builder = new CSRBuilder<double, int>(opts);
+
+    PyObject *capsule = PyCapsule_New(builder, CSR_BUILDER_CAPSULE,
+                                      destroy_csr_builder);
+    if (!capsule)
+      delete builder;
+    return capsule;
+
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+static const char csr_builder_append_doc[] =
+  "Parse one more file onto a CSR builder; returns the number of rows\n"
+  "appended.";
+
+extern "C" {
+static PyObject *csr_builder_append(PyObject *self, PyObject *args)
+{
+  try {
+    PyObject *capsule;
+    char const *file_path;
+
+    if (!PyArg_ParseTuple(args, "Os", &capsule, &file_path))
+      return 0;
+
+    CSRBuilderBase *builder =
+      (CSRBuilderBase *)PyCapsule_GetPointer(capsule,
+                                             CSR_BUILDER_CAPSULE);
+    if (!builder)
+      return 0;
+
+    size_t n_rows = 0;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+      n_rows = builder->append_file(file_path);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (error)
+      std::rethrow_exception(error);
+
+    return PyLong_FromSize_t(n_rows);
+
+  } catch (SyntaxError const &e) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+    return 0;
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::ios_base::failure const &e) {
+    PyErr_SetString(PyExc_IOError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+static const char csr_builder_take_doc[] =
+  "Snapshot a CSR builder's accumulation as a CSR tuple. copy=1 leaves\n"
+  "the builder growing; copy=0 steals the arrays and empties it.";
+
+extern "C" {
+static PyObject *csr_builder_take(PyObject *self, PyObject *args)
+{
+  try {
+    PyObject *capsule;
+    int copy = 1;
+
+    if (!PyArg_ParseTuple(args, "O|i", &capsule, &copy))
+      return 0;
+
+    CSRBuilderBase *builder =
+      (CSRBuilderBase *)PyCapsule_GetPointer(capsule,
+                                             CSR_BUILDER_CAPSULE);
+    if (!builder)
+      return 0;
+
+    return builder->take_csr(copy != 0);
+
+  } catch (std::bad_alloc const &e) {
+    PyErr_SetString(PyExc_MemoryError, e.what());
+    return 0;
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM reader: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+/*
+ * Text formatting helpers for the dumper. Numbers are formatted with a
+ * plain itoa and a shortest-round-trip double formatter straight into
+ * an in-memory buffer, which is written in multi-megabyte chunks; this
+ * replaces per-number operator<< (locale machinery) and per-row
+ * std::endl (a flush per row).
+ */
+
+static const size_t DUMP_FLUSH_BYTES = 4 * 1024 * 1024;
+
+static bool has_suffix(char const *s, char const *suffix)
+{
+  size_t n = std::strlen(s), m = std::strlen(suffix);
+  return n >= m && std::memcmp(s + n - m, suffix, m) == 0;
+}
+
+/*
+ * Output target for the dumper. A path ending in ".gz" or ".zst" is
+ * compressed on the fly and anything else written plain; alternatively
+ * the caller can hand over an open file descriptor (socket, pipe,
+ * pre-opened object-storage upload) or a fixed-size memory buffer,
+ * both written raw.
+ */
+class DumpSink {
+public:
+  explicit DumpSink(char const *file_path)
+    : fd_(-1), dst_(0), dst_cap_(0), dst_pos_(0), gz_(0)
+#ifdef HAVE_ZSTD
+    , zstd_(0)
+#endif
+  {
+    if (has_suffix(file_path, ".gz")) {
+      gz_ = gzopen(file_path, "wb");
+      if (!gz_)
+        throw std::ios_base::failure("Cannot open file for writing!");
+    } else if (has_suffix(file_path, ".zst")) {
+#ifdef HAVE_ZSTD
+      out_.open(file_path, std::ofstream::out | std::ofstream::trunc
+                           | std::ofstream::binary);
+      if (!out_)
+        throw std::ios_base::failure("Cannot open file for writing!");
+      zstd_ = ZSTD_createCStream();
+      if (!zstd_)
+        throw std::bad_alloc();
+      zbuf_.resize(ZSTD_CStreamOutSize());
+#else
+      throw std::runtime_error(".zst output, but zstd support was not "
+                               "compiled in");
+#endif
+    } else {
+      out_.open(file_path, std::ofstream::out | std::ofstream::trunc);
+      if (!out_)
+        throw std::ios_base::failure("Cannot open file for writing!");
+    }
+  }
+
+  // Caller-owned descriptor: written as-is and not closed here.
+  explicit DumpSink(int fd)
+    : fd_(fd), dst_(0), dst_cap_(0), dst_pos_(0), gz_(0)
+#ifdef HAVE_ZSTD
+    , zstd_(0)
+#endif
+  {
+#ifndef HAVE_MMAP
+    throw std::runtime_error("file-descriptor output is not supported "
+                             "on this platform");
+#endif
+  }
+
+  // Caller-owned memory buffer of fixed capacity.
+  DumpSink(char *dst, size_t capacity)
+    : fd_(-1), dst_(dst), dst_cap_(capacity), dst_pos_(0), gz_(0)
+#ifdef HAVE_ZSTD
+    , zstd_(0)
+#endif
+  {
+  }
+
+  size_t bytes_written() const { return dst_pos_; }
+
+  ~DumpSink()
+  {
+    if (gz_)
+      gzclose(gz_);
+#ifdef HAVE_ZSTD
+    if (zstd_) {
+      try {
+        zstd_flush(true);
+      } catch (...) {}
+      ZSTD_freeCStream(zstd_);
+    }
+#endif
+  }
+
+  void write(char const *p, size_t n)
+  {
+    if (n == 0)
+      return;
+    if (dst_) {
+      if (n > dst_cap_ - dst_pos_)
+        throw std::runtime_error("output buffer too small");
+      std::memcpy(dst_ + dst_pos_, p, n);
+      dst_pos_ += n;
+      return;
+    }
+#ifdef HAVE_MMAP
+    if (fd_ >= 0) {
+      while (n > 0) {
+        ssize_t written = ::write(fd_, p, n);
+        if (written < 0) {
+          if (errno == EINTR)
+            continue;
+          throw std::ios_base::failure("write failed");
+        }
+        p += written;
+        n -= written;
+      }
+      return;
+    }
+#endif
+    if (gz_) {
+      if ((size_t)gzwrite(gz_, p, n) != n)
+        throw std::ios_base::failure("gzip write failed");
+      return;
+    }
+#ifdef HAVE_ZSTD
+    if (zstd_) {
+      input_ = p;
+      input_size_ = n;
+      input_pos_ = 0;
+      zstd_flush(false);
+      return;
+    }
+#endif
+    out_.write(p, n);
+    if (!out_)
+      throw std::ios_base::failure("write failed");
+  }
+
+private:
+  DumpSink(DumpSink const &);
+  DumpSink &operator=(DumpSink const &);
+
+#ifdef HAVE_ZSTD
+  void zstd_flush(bool end)
+  {
+    ZSTD_inBuffer in = { input_, input_size_, input_pos_ };
+    size_t remaining;
+    do {
+      ZSTD_outBuffer out = { &zbuf_[0], zbuf_.size(), 0 };
+      remaining = ZSTD_compressStream2(zstd_, &out, &in,
+                                       end ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(remaining))
+        throw std::runtime_error(std::string("zstd error: ")
+                                 + ZSTD_getErrorName(remaining));
+      out_.write(&zbuf_[0], out.pos);
+    } while (end ? remaining != 0 : in.pos < in.size);
+    input_ = 0;
+    input_size_ = input_pos_ = 0;
+  }
+#endif
+
+  std::ofstream out_;
+  int fd_;
+  char *dst_;
+  size_t dst_cap_, dst_pos_;
+  gzFile gz_;
+#ifdef HAVE_ZSTD
+  ZSTD_CStream *zstd_;
+  std::vector<char> zbuf_;
+  char const *input_;
+  size_t input_size_, input_pos_;
+#endif
+};
+
+static void append_int(std::vector<char> &out, long long v)
+{
+  char tmp[24];
+  char *p = tmp + sizeof(tmp);
+  bool negative = v < 0;
+  unsigned long long u = negative ? -(unsigned long long)v : v;
+
+  do {
+    *--p = '0' + (char)(u % 10);
+    u /= 10;
+  } while (u);
+  if (negative)
+    *--p = '-';
+
+  out.insert(out.end(), p, tmp + sizeof(tmp));
+}
+
+static void append_double(std::vector<char> &out, double v)
+{
+  // Most values in sparse ML data are small integers; itoa them.
+  if (v == (double)(long long)v && v > -1e15 && v < 1e15) {
+    append_int(out, (long long)v);
+    return;
+  }
+
+  // Shortest representation that round-trips: try 15 significant
+  // digits, fall back to 17 when that loses bits.
+  char tmp[32];
+  int n = std::snprintf(tmp, sizeof(tmp), "%.15g", v);
+  if (std::strtod(tmp, 0) != v)
+    n = std::snprintf(tmp, sizeof(tmp), "%.17g", v);
+  out.insert(out.end(), tmp, tmp + n);
+}
+
+/*
+ * Format CSR rows [row_begin, row_end), appending the text to out.
+ */
+static void format_rows(double const *y, double const *data,
+                        int const *indices, int const *indptr,
+                        int row_begin, int row_end, int zero_based,
+                        std::vector<char> &out)
+{
+  for (int i = row_begin; i < row_end; i++) {
+    append_double(out, y[i]);
+    out.push_back(' ');
+    for (int jj = indptr[i]; jj < indptr[i + 1]; jj++) {
+      int idx = indices[jj];
+      if (!zero_based)
+        idx++;
+      append_int(out, idx);
+      out.push_back(':');
+      append_double(out, data[jj]);
+      out.push_back(' ');
+    }
+    out.push_back('\n');
+  }
+}
+
+/*
+ * Per-thread state for the parallel dumper: each worker formats its row
+ * range into a private buffer, then the buffers are written in order.
+ */
+struct DumpChunk {
+  int row_begin, row_end;
+  std::vector<char> text;
+  std::exception_ptr error;
+};
+
+static void format_chunk(DumpChunk &chunk, double const *y,
+                         double const *data, int const *indices,
+                         int const *indptr, int zero_based)
+{
+  try {
+    format_rows(y, data, indices, indptr,
+                chunk.row_begin, chunk.row_end, zero_based, chunk.text);
+  } catch (...) {
+    chunk.error = std::current_exception();
+  }
+}
+
+/*
+ * Dump a CSR to file_path. With n_threads > 1 the rows are partitioned
+ * evenly across worker threads -- formatting is embarrassingly parallel
+ * since the row data is already in contiguous arrays -- at the cost of
+ * holding the formatted text in memory; the serial path streams with a
+ * bounded buffer instead.
+ */
+static void dump_file(DumpSink &out, int n_samples,
+                      double const *y, double const *data,
+                      int const *indices, int const *indptr,
+                      int zero_based, unsigned n_threads)
+{
+  if (n_threads >= 2 && n_samples >= (int)n_threads) {
+    std::vector<DumpChunk> chunks(n_threads);
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < n_threads; ++t) {
+      chunks[t].row_begin = (int)((long long)n_samples * t / n_threads);
+      chunks[t].row_end = (int)((long long)n_samples * (t + 1) / n_threads);
+      workers.push_back(std::thread(format_chunk, std::ref(chunks[t]),
+                                    y, data, indices, indptr, zero_based));
+    }
+    for (unsigned t = 0; t < n_threads; ++t)
+      workers[t].join();
+    for (unsigned t = 0; t < n_threads; ++t)
+      if (chunks[t].error)
+        std::rethrow_exception(chunks[t].error);
+
+    for (unsigned t = 0; t < n_threads; ++t)
+      if (!chunks[t].text.empty())
+        out.write(&chunks[t].text[0], chunks[t].text.size());
+    return;
+  }
+
+  std::vector<char> buf;
+  buf.reserve(DUMP_FLUSH_BYTES);
+  for (int i = 0; i < n_samples; i++) {
+    format_rows(y, data, indices, indptr, i, i + 1, zero_based, buf);
+    if (buf.size() >= DUMP_FLUSH_BYTES) {
+      out.write(&buf[0], buf.size());
+      buf.clear();
+    }
+  }
+  if (!buf.empty())
+    out.write(&buf[0], buf.size());
+}
+
+static const char dump_svmlight_file_doc[] =
+  "Dump CSR matrix in svmlight format to a file path or an open\n"
+  "file descriptor.";
+
+extern "C" {
+static PyObject *dump_svmlight_file(PyObject *self, PyObject *args)
+{
+  try {
+    // Read function arguments.
+    PyObject *target;
+    PyArrayObject *indices_array, *indptr_array, *data_array, *label_array;
+    int zero_based;
+    int n_threads = 1;
+
+    if (!PyArg_ParseTuple(args,
+                          "OO!O!O!O!i|i",
+                          &target,
+                          &PyArray_Type, &data_array,
+                          &PyArray_Type, &indices_array,
+                          &PyArray_Type, &indptr_array,
+                          &PyArray_Type, &label_array,
+                          &zero_based,
+                          &n_threads))
+      return 0;
+
+    // Text strings are file paths; integers are open descriptors the
+    // caller keeps ownership of.
+    char const *file_path = 0;
+    long fd = -1;
+    if (
+#if PY_MAJOR_VERSION < 3
+        PyString_Check(target) ||
+#endif
+        PyUnicode_Check(target)) {
+      if (!PyArg_Parse(target, "s", &file_path))
+        return 0;
+    } else {
+      fd = PyLong_AsLong(target);
+      if (fd == -1 && PyErr_Occurred())
+        return 0;
+      if (fd < 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "file descriptor must be non-negative");
+        return 0;
+      }
+    }
+
+    int n_samples = indptr_array->dimensions[0] - 1;
+    double *data = (double*) data_array->data;
+    int *indices = (int*) indices_array->data;
+    int *indptr = (int*) indptr_array->data;
+    double *y = (double*) label_array->data;
+
+    if (n_threads < 1)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Only borrowed array memory is touched from here on; release the
+    // GIL so formatting threads can run unimpeded.
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+      if (file_path) {
+        DumpSink out(file_path);
+        dump_file(out, n_samples, y, data, indices, indptr,
+                  zero_based, n_threads);
+      } else {
+        DumpSink out((int)fd);
+        dump_file(out, n_samples, y, data, indices, indptr,
+                  zero_based, n_threads);
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    if (error)
+      std::rethrow_exception(error);
+
+    Py_INCREF(Py_None);
+    return Py_None;
+
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM writer: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+
+static const char dump_svmlight_buffer_doc[] =
+  "Dump CSR matrix in svmlight format into a caller-supplied writable\n"
+  "buffer (bytearray, writable memoryview, mmap); returns the number\n"
+  "of bytes written.";
+
+static PyObject *dump_svmlight_buffer(PyObject *self, PyObject *args)
+{
+  try {
+    PyObject *target;
+    PyArrayObject *indices_array, *indptr_array, *data_array, *label_array;
+    int zero_based;
+    int n_threads = 1;
+
+    if (!PyArg_ParseTuple(args,
+                          "OO!O!O!O!i|i",
+                          &target,
+                          &PyArray_Type, &data_array,
+                          &PyArray_Type, &indices_array,
+                          &PyArray_Type, &indptr_array,
+                          &PyArray_Type, &label_array,
+                          &zero_based,
+                          &n_threads))
+      return 0;
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(target, &view, PyBUF_WRITABLE) < 0)
+      return 0;
+
+    int n_samples = indptr_array->dimensions[0] - 1;
+    double *data = (double*) data_array->data;
+    int *indices = (int*) indices_array->data;
+    int *indptr = (int*) indptr_array->data;
+    double *y = (double*) label_array->data;
+
+    if (n_threads < 1)
+      n_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    size_t written = 0;
+    std::exception_ptr error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+      DumpSink out((char *)view.buf, (size_t)view.len);
+      dump_file(out, n_samples, y, data, indices, indptr,
+                zero_based, n_threads);
+      written = out.bytes_written();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    if (error)
+      std::rethrow_exception(error);
+
+    return PyLong_FromSize_t(written);
+
+  } catch (std::exception const &e) {
+    std::string msg("error in SVMlight/libSVM writer: ");
+    msg += e.what();
+    PyErr_SetString(PyExc_RuntimeError, msg.c_str());
+    return 0;
+  }
+}
+}
+
+
+/*
+ * Python module setup.
+ */
+
+static PyMethodDef svmlight_format_methods[] = {
+  {"_load_svmlight_file", load_svmlight_file,
+    METH_VARARGS, load_svmlight_file_doc},
+
+  {"_load_svmlight_files", load_svmlight_files,
+    METH_VARARGS, load_svmlight_files_doc},
+
+  {"_open_chunk_reader", open_chunk_reader,
+    METH_VARARGS, open_chunk_reader_doc},
+
+  {"_read_chunk", read_chunk,
+    METH_VARARGS, read_chunk_doc},
+  {"_csr_builder_new", csr_builder_new,
+    METH_VARARGS, csr_builder_new_doc},
+  {"_csr_builder_append", csr_builder_append,
+    METH_VARARGS, csr_builder_append_doc},
+  {"_csr_builder_take", csr_builder_take,
+    METH_VARARGS, csr_builder_take_doc},
+
+  {"_dump_svmlight_file", dump_svmlight_file,
+    METH_VARARGS, dump_svmlight_file_doc},
+
+  {"_dump_svmlight_buffer", dump_svmlight_buffer,
+    METH_VARARGS, dump_svmlight_buffer_doc},
+
+  {NULL, NULL, 0, NULL}
+};
+
+static const char svmlight_format_doc[] =
+  "Loader/Writer for svmlight / libsvm datasets - C++ helper routines";
+
+extern "C" {
+#if PY_MAJOR_VERSION >= 3
+static struct PyModuleDef _svmlight_loader_definition = { 
+    PyModuleDef_HEAD_INIT,
+    "_svmlight_loader",
+    svmlight_format_doc,
+    -1, 
+    svmlight_format_methods
+};
+
+PyMODINIT_FUNC PyInit__svmlight_loader(void)
+{
+  Py_Initialize();
+  import_array();
+
+  init_type_objs();
+  for (PyTypeObject **t = owner_types; *t; ++t)
+    if (PyType_Ready(*t) < 0)
+      return NULL;
+
+  return PyModule_Create(&_svmlight_loader_definition);
+
+}
+#else 
+PyMODINIT_FUNC init_svmlight_loader(void)
+{
+  _import_array();
+
+  init_type_objs();
+  for (PyTypeObject **t = owner_types; *t; ++t)
+    if (PyType_Ready(*t) < 0)
+      return;
 
   Py_InitModule3("_svmlight_loader",
                  svmlight_format_methods,
@@ -0,0 +1,153 @@
+"""Benchmark harness for svmlight_loader.
+
+Synthesizes svmlight files across a few representative regimes and
+reports rows/s, MB/s and peak RSS for load and dump, so a change to the
+parser or writer can be validated against more than the tiny test
+fixture.
+
+Each measurement runs in its own subprocess: peak RSS as reported by
+getrusage() is a process-lifetime high-water mark, so sharing a process
+between measurements would let an early benchmark inflate the numbers
+of every later one.
+
+Usage:
+    python benchmarks/bench.py                  # all regimes, all ops
+    python benchmarks/bench.py --regime ctr --rows 100000
+"""
+
+import json
+import optparse
+import os
+import resource
+import subprocess
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+
+# Row counts are sized so the default run finishes in minutes; scale
+# with --rows when hunting for effects that only show at production
+# sizes (reallocation cliffs, TLB pressure, NUMA).
+REGIMES = {
+    # Wide and very sparse, like click-through-rate data: hashed
+    # features, few nonzeros per row, long-tail value distribution.
+    "ctr": dict(n_rows=200000, n_features=10000000, nnz_per_row=30,
+                values="longtail"),
+    # Dense-ish, like vision descriptors: narrow feature space, most
+    # features present per row.
+    "vision": dict(n_rows=5000, n_features=4096, nnz_per_row=1200,
+                   values="uniform"),
+    # Mid-width with long-tail values, like n-gram counts.
+    "text": dict(n_rows=100000, n_features=262144, nnz_per_row=120,
+                 values="longtail"),
+}
+
+OPS = ["load", "load-parallel", "load-prescan", "dump"]
+
+
+def generate(path, n_rows, n_features, nnz_per_row, values, seed=0):
+    """Write a synthetic one-based svmlight file."""
+    rng = np.random.RandomState(seed)
+    with open(path, "w") as f:
+        for _ in range(n_rows):
+            nnz = max(1, int(rng.poisson(nnz_per_row)))
+            idx = np.unique(rng.randint(1, n_features + 1, nnz))
+            if values == "longtail":
+                val = rng.lognormal(0.0, 2.0, idx.shape[0])
+            else:
+                val = rng.uniform(-1.0, 1.0, idx.shape[0])
+            label = 1 if rng.rand() < 0.5 else -1
+            f.write("%d %s\n" % (label, " ".join(
+                "%d:%.6g" % (i, v) for i, v in zip(idx, val))))
+
+
+def peak_rss_mb():
+    rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if sys.platform == "darwin":
+        rss //= 1024            # darwin reports bytes, linux kilobytes
+    return rss / 1024.0
+
+
+def run_one(op, path):
+    """Run a single measurement and print a JSON record on stdout."""
+    from svmlight_loader import load_svmlight_file, dump_svmlight_file
+
+    if op == "dump":
+        X, y = load_svmlight_file(path)
+
+    t0 = time.time()
+    if op == "load":
+        X, y = load_svmlight_file(path)
+    elif op == "load-parallel":
+        X, y = load_svmlight_file(path, n_threads=-1)
+    elif op == "load-prescan":
+        X, y = load_svmlight_file(path, prescan=True)
+    elif op == "dump":
+        dump_svmlight_file(X, y, path + ".out", zero_based=False)
+    else:
+        raise ValueError("unknown op: %r" % op)
+    elapsed = time.time() - t0
+
+    if op == "dump":
+        n_bytes = os.path.getsize(path + ".out")
+        os.remove(path + ".out")
+    else:
+        n_bytes = os.path.getsize(path)
+
+    print(json.dumps(dict(op=op, seconds=elapsed, n_rows=X.shape[0],
+                          n_bytes=n_bytes, peak_rss_mb=peak_rss_mb())))
+
+
+def measure(op, path):
+    out = subprocess.check_output(
+        [sys.executable, os.path.abspath(__file__), "--run", op, path],
+        cwd=os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+    return json.loads(out.decode("ascii").strip().splitlines()[-1])
+
+
+def main():
+    parser = optparse.OptionParser(usage=__doc__)
+    parser.add_option("--regime", default=None,
+                      help="benchmark a single regime: %s"
+                           % ", ".join(sorted(REGIMES)))
+    parser.add_option("--rows", type="int", default=None,
+                      help="override the per-regime row count")
+    parser.add_option("--op", default=None,
+                      help="benchmark a single op: %s" % ", ".join(OPS))
+    parser.add_option("--run", nargs=2, default=None,
+                      help="internal: run one measurement in-process")
+    options, _ = parser.parse_args()
+
+    if options.run is not None:
+        run_one(*options.run)
+        return
+
+    regimes = [options.regime] if options.regime else sorted(REGIMES)
+    ops = [options.op] if options.op else OPS
+
+    print("%-8s %-14s %10s %10s %8s %10s" %
+          ("regime", "op", "rows/s", "MB/s", "sec", "peakRSS_MB"))
+    for name in regimes:
+        spec = dict(REGIMES[name])
+        if options.rows:
+            spec["n_rows"] = options.rows
+
+        fd, path = tempfile.mkstemp(suffix=".txt", prefix="bench_%s_" % name)
+        os.close(fd)
+        try:
+            generate(path, **spec)
+            for op in ops:
+                r = measure(op, path)
+                print("%-8s %-14s %10.0f %10.1f %8.2f %10.1f" %
+                      (name, op,
+                       r["n_rows"] / r["seconds"],
+                       r["n_bytes"] / r["seconds"] / 1e6,
+                       r["seconds"], r["peak_rss_mb"]))
+        finally:
+            os.remove(path)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,9 +1,27 @@
 from distutils.core import setup, Extension
+import os
 import numpy as np
 
+libraries = ['z']
+define_macros = []
+
+# zstd support is optional; enable with SVMLIGHT_LOADER_ZSTD=1.
+if os.environ.get('SVMLIGHT_LOADER_ZSTD'):
+    libraries.append('zstd')
+    define_macros.append(('HAVE_ZSTD', '1'))
+
+# io_uring + O_DIRECT read backend (Linux, needs liburing); enable
+# with SVMLIGHT_LOADER_URING=1.
+if os.environ.get('SVMLIGHT_LOADER_URING'):
+    libraries.append('uring')
+    define_macros.append(('HAVE_IO_URING', '1'))
+
 ext = Extension('_svmlight_loader',
                 include_dirs = [np.get_include(),'.'],
-                extra_compile_args=['-O3'],
+                extra_compile_args=['-O3', '-std=c++11', '-pthread'],
+                extra_link_args=['-pthread'],
+                libraries = libraries,
+                define_macros = define_macros,
                 sources = ['_svmlight_loader.cpp'])
 
 setup (name = 'svmlight-loader',
@@ -1,11 +1,14 @@
 import numpy as np
 import os
+import scipy.sparse as sp
+import warnings
 
 from numpy.testing import assert_equal, assert_array_equal
 from nose.tools import raises
 
 from svmlight_loader import (load_svmlight_file, load_svmlight_files,
-                             dump_svmlight_file)
+                             load_svmlight_chunks, dump_svmlight_file,
+                             CSRBuilder)
 from sklearn.datasets import load_svmlight_file as sk_load_svmlight_file
 
 currdir = os.path.dirname(os.path.abspath(__file__))
@@ -44,6 +47,99 @@ def test_load_svmlight_file():
     assert_array_equal(y, [1, 2, 3])
 
 
+def test_load_svmlight_file_parallel():
+    X, y = load_svmlight_file(datafile)
+    X2, y2 = load_svmlight_file(datafile, n_threads=2)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+    X3, y3 = load_svmlight_file(datafile, n_threads=-1)
+    assert_array_equal(X.toarray(), X3.toarray())
+    assert_array_equal(y, y3)
+
+
+def test_load_svmlight_file_parallel_large():
+    # The fixture is far below the size threshold where the parallel
+    # parser engages, so the test above really runs single-threaded.
+    # Generate enough rows that the file is split into chunks and the
+    # per-chunk results stitched back together.
+    tmpfile = "tmp_parallel.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            for i in range(1000):
+                f.write("%d %d:%d.5 %d:0.25\n"
+                        % (i % 7, i % 50 + 1, i % 9, i % 50 + 2))
+        assert os.path.getsize(tmpfile) >= 3 * 4096
+
+        X, y = load_svmlight_file(tmpfile)
+        X2, y2 = load_svmlight_file(tmpfile, n_threads=3)
+        assert_array_equal(y, y2)
+        assert_array_equal(X.toarray(), X2.toarray())
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_svmlight_file_parallel_query_id():
+    tmpfile = "tmp_parallel_qid.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            for i in range(1000):
+                f.write("%d qid:%d %d:1.5 %d:0.25\n"
+                        % (i % 7, i // 10, i % 50 + 1, i % 50 + 2))
+        assert os.path.getsize(tmpfile) >= 3 * 4096
+
+        X, y, q = load_svmlight_file(tmpfile, query_id=True)
+        X2, y2, q2 = load_svmlight_file(tmpfile, query_id=True,
+                                        n_threads=3)
+        assert_array_equal(y, y2)
+        assert_array_equal(q, q2)
+        assert_array_equal(X.toarray(), X2.toarray())
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_svmlight_file_parallel_skip():
+    # Quarantined line numbers must be file-global even when the bad
+    # lines land in different chunks.
+    tmpfile = "tmp_parallel_skip.txt"
+    bad = (150, 500, 900)
+    try:
+        with open(tmpfile, "w") as f:
+            for i in range(1000):
+                if i + 1 in bad:
+                    f.write("not a label %d:1.0\n" % (i % 50 + 1))
+                else:
+                    f.write("%d %d:%d.5 %d:0.25\n"
+                            % (i % 7, i % 50 + 1, i % 9, i % 50 + 2))
+        assert os.path.getsize(tmpfile) >= 3 * 4096
+
+        with warnings.catch_warnings():
+            warnings.simplefilter("ignore")
+            X, y, stats = load_svmlight_file(tmpfile, on_error="skip",
+                                             return_stats=True)
+            X2, y2, stats2 = load_svmlight_file(tmpfile, on_error="skip",
+                                                return_stats=True,
+                                                n_threads=3)
+        assert_equal(stats2["skipped_lines"], 3)
+        assert_equal(stats2["bad_lines"], list(bad))
+        assert_array_equal(y, y2)
+        assert_array_equal(X.toarray(), X2.toarray())
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_svmlight_file_prescan():
+    X, y = load_svmlight_file(datafile)
+
+    X2, y2 = load_svmlight_file(datafile, prescan=True)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+    X3, y3 = load_svmlight_file(datafile, n_samples=3, nnz=6)
+    assert_array_equal(X.toarray(), X3.toarray())
+    assert_array_equal(y, y3)
+
+
 def test_load_svmlight_files():
     X_train, y_train, X_test, y_test = load_svmlight_files([datafile] * 2,
                                                            dtype=np.float32)
@@ -59,6 +155,49 @@ def test_load_svmlight_files():
     assert_equal(X3.dtype, np.float64)
 
 
+def test_load_svmlight_files_shared_features():
+    tmpfile = "tmp_narrow.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1 1:1.0 3:2.0\n")
+        # The width is inferred jointly, so the narrow shard comes back
+        # as wide as the widest one.
+        X1, y1, X2, y2 = load_svmlight_files([datafile, tmpfile])
+        assert_equal(X1.shape[1], 20)
+        assert_equal(X2.shape[1], 20)
+        assert_array_equal(y2, [1])
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_svmlight_file_dtypes():
+    X, y = load_svmlight_file(datafile)
+
+    X32, y32 = load_svmlight_file(datafile, dtype=np.float32)
+    assert_equal(X32.dtype, np.float32)
+    assert_equal(y32.dtype, np.float64)
+    assert_array_equal(X.toarray().astype(np.float32), X32.toarray())
+
+    X64, y64 = load_svmlight_file(datafile, index_dtype=np.int64)
+    assert_equal(X64.indices.dtype, np.int64)
+    assert_equal(X64.indptr.dtype, np.int64)
+    assert_array_equal(X.toarray(), X64.toarray())
+
+
+def test_load_svmlight_file_zero_based():
+    X, y = load_svmlight_file(datafile)
+
+    # The test file is one-based, so "auto" (the default) and an
+    # explicit False agree.
+    X2, y2 = load_svmlight_file(datafile, zero_based=False)
+    assert_array_equal(X.toarray(), X2.toarray())
+
+    # zero_based=True keeps the raw indices.
+    X3, y3 = load_svmlight_file(datafile, zero_based=True)
+    assert_equal(X3.shape[1], 21)
+    assert_array_equal(X.toarray(), X3.toarray()[:, 1:])
+
+
 def test_load_svmlight_file_n_features():
     X, y = load_svmlight_file(datafile, n_features=14)
 
@@ -74,6 +213,394 @@ def test_load_svmlight_file_n_features():
         assert_equal(X[i, j], val)
 
 
+def test_load_svmlight_file_hugepages():
+    X, y = load_svmlight_file(datafile)
+
+    X2, y2 = load_svmlight_file(datafile, hugepages=True)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+    # Arena-backed arrays must still be writable.
+    X2[0, 1] *= 2
+    assert_equal(X2[0, 1], 5)
+
+
+def test_load_svmlight_file_cache():
+    cachefile = datafile + ".cache"
+    try:
+        X, y = load_svmlight_file(datafile)
+
+        # First cached load parses and writes the sidecar ...
+        X2, y2 = load_svmlight_file(datafile, cache=True)
+        assert os.path.exists(cachefile)
+        assert_array_equal(X.toarray(), X2.toarray())
+        assert_array_equal(y, y2)
+
+        # ... the second one memory-maps it.
+        X3, y3 = load_svmlight_file(datafile, cache=True)
+        assert_array_equal(X.toarray(), X3.toarray())
+        assert_array_equal(y, y3)
+
+        # Mapped arrays are copy-on-write: writes must not corrupt
+        # the cache for later loads.
+        X3[0, 1] *= 2
+        X4, y4 = load_svmlight_file(datafile, cache=True)
+        assert_array_equal(X.toarray(), X4.toarray())
+    finally:
+        if os.path.exists(cachefile):
+            os.remove(cachefile)
+
+
+def test_load_svmlight_file_cache_hit():
+    # Prove the second load really comes from the cache: rewrite the
+    # source but keep its mtime older than the sidecar's, so a true
+    # cache hit returns the old contents while a silent reparse would
+    # return the new ones.
+    tmpfile = "tmp_cache_hit.txt"
+    cachefile = tmpfile + ".cache"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1 1:1.0 3:2.0\n2 2:4.0\n")
+        X, y = load_svmlight_file(tmpfile, cache=True)
+        assert os.path.exists(cachefile)
+
+        with open(tmpfile, "w") as f:
+            f.write("3 1:9.0\n")
+        backdated = os.path.getmtime(cachefile) - 10
+        os.utime(tmpfile, (backdated, backdated))
+
+        X2, y2 = load_svmlight_file(tmpfile, cache=True)
+        assert_array_equal(y2, [1, 2])
+        assert_array_equal(X.toarray(), X2.toarray())
+    finally:
+        for f in (tmpfile, cachefile):
+            if os.path.exists(f):
+                os.remove(f)
+
+
+def test_load_svmlight_chunks():
+    X, y = load_svmlight_file(datafile, n_features=20)
+
+    chunks = list(load_svmlight_chunks(datafile, chunk_rows=2,
+                                       n_features=20))
+    assert_equal(len(chunks), 2)
+    assert_equal(chunks[0][0].shape[0], 2)
+    assert_equal(chunks[1][0].shape[0], 1)
+
+    X2 = sp.vstack([Xc for Xc, yc in chunks])
+    y2 = np.concatenate([yc for Xc, yc in chunks])
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+
+def test_load_query_id():
+    tmpfile = "tmp_qid.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("2 qid:1 1:0.5 3:1.0 # judged\n")
+            f.write("1 qid:1 2:2.0\n")
+            f.write("0 qid:2 1:1.0\n")
+        X, y, qids = load_svmlight_file(tmpfile, query_id=True)
+        assert_array_equal(y, [2, 1, 0])
+        assert_array_equal(qids, [1, 1, 2])
+        assert_equal(X[0, 0], 0.5)
+        assert_equal(X[1, 1], 2.0)
+
+        # Files without qid tokens return an empty qid array.
+        X2, y2, qids2 = load_svmlight_file(datafile, query_id=True)
+        assert_equal(qids2.shape[0], 0)
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_multilabel():
+    tmpfile = "tmp_multilabel.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1,3,7 4:0.5 9:1.0\n")
+            f.write("2 1:1.0\n")
+            f.write(" 5:2.5\n")          # no labels at all
+        X, y = load_svmlight_file(tmpfile, multilabel=True)
+        values, label_indptr = y
+        assert_array_equal(values, [1, 3, 7, 2])
+        assert_array_equal(label_indptr, [0, 3, 4, 4])
+        assert_equal(X.shape[0], 3)
+        assert_equal(X[0, 3], 0.5)
+        assert_equal(X[2, 4], 2.5)
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_byte_range():
+    # Consecutive (offset, length) byte ranges partition the rows.
+    size = os.path.getsize(datafile)
+    half = size // 2
+    X, y = load_svmlight_file(datafile)
+    X1, y1 = load_svmlight_file(datafile, offset=0, length=half)
+    X2, y2 = load_svmlight_file(datafile, offset=half)
+    assert_array_equal(np.concatenate([y1, y2]), y)
+    assert_equal(X1.shape[0] + X2.shape[0], X.shape[0])
+
+
+def test_load_sample_rate():
+    X1, y1 = load_svmlight_file(datafile, sample_rate=0.5, seed=42)
+    X2, y2 = load_svmlight_file(datafile, sample_rate=0.5, seed=42)
+    assert_array_equal(y1, y2)
+    assert_array_equal(X1.toarray(), X2.toarray())
+    X3, y3 = load_svmlight_file(datafile, sample_rate=1.0, seed=42)
+    X, y = load_svmlight_file(datafile)
+    assert_array_equal(y3, y)
+
+
+def test_load_feature_subset():
+    X, y = load_svmlight_file(datafile)
+    # Ids are file coordinates: the fixture is one-based, so column j
+    # of X came from file id j + 1.
+    keep = [2, 12, 20]
+    X2, y2 = load_svmlight_file(datafile, feature_subset=keep,
+                                n_features=X.shape[1])
+    assert_array_equal(y, y2)
+    expected = X.toarray()
+    dropped = [j for j in range(X.shape[1]) if j + 1 not in keep]
+    expected[:, dropped] = 0
+    assert_array_equal(expected, X2.toarray())
+
+
+def test_load_max_feature():
+    X, y = load_svmlight_file(datafile)
+    X2, y2 = load_svmlight_file(datafile, max_feature=12,
+                                n_features=X.shape[1])
+    assert_array_equal(y, y2)
+    expected = X.toarray()
+    expected[:, 12:] = 0
+    assert_array_equal(expected, X2.toarray())
+
+
+def test_load_read_ahead():
+    X, y = load_svmlight_file(datafile)
+    X2, y2 = load_svmlight_file(datafile, read_ahead=True, buffer_mb=1)
+    assert_array_equal(y, y2)
+    assert_array_equal(X.toarray(), X2.toarray())
+
+
+def test_load_return_stats():
+    X, y, stats = load_svmlight_file(datafile, return_stats=True)
+    assert_equal(stats["rows"], X.shape[0])
+    assert_equal(stats["nnz"], X.nnz)
+    assert_equal(stats["bytes_read"], os.path.getsize(datafile))
+    assert_equal(stats["recovered_lines"], 0)
+    assert stats["parse_seconds"] >= 0.0
+
+
+def test_load_label_stats():
+    X, y, stats = load_svmlight_file(datafile, return_stats=True)
+    assert_equal(stats["label_min"], 1.0)
+    assert_equal(stats["label_max"], 3.0)
+    assert_equal(stats["label_counts"], {1.0: 1, 2.0: 1, 3.0: 1})
+    # Rows in datafile carry 3, 2 and 1 nonzeros respectively.
+    assert_equal(stats["nnz_per_row"], {1: 1, 2: 1, 3: 1})
+
+
+def test_manifest_roundtrip():
+    tmpfile = "tmp_manifest.txt"
+    try:
+        # Last column empty: without the manifest the width is
+        # inferred short.
+        X = sp.csr_matrix(np.array([[0.0, 1.0, 0.0, 0.0],
+                                    [2.0, 0.0, 3.0, 0.0]]))
+        y = np.array([1.0, 2.0])
+        dump_svmlight_file(X, y, tmpfile, zero_based=True, manifest=True)
+        assert os.path.exists(tmpfile + ".manifest")
+        X2, y2 = load_svmlight_file(tmpfile)
+        assert_equal(X2.shape, X.shape)
+        assert_array_equal(X.toarray(), X2.toarray())
+        assert_array_equal(y, y2)
+    finally:
+        for f in (tmpfile, tmpfile + ".manifest"):
+            if os.path.exists(f):
+                os.remove(f)
+
+
+def test_load_on_error_skip():
+    # First line of the fixture has a non-numeric label; the two good
+    # rows survive and the bad one is reported by line number.
+    with warnings.catch_warnings():
+        warnings.simplefilter("ignore")
+        X, y, stats = load_svmlight_file(invalidfile, on_error="skip",
+                                         return_stats=True)
+    assert_array_equal(y, [2, 3])
+    assert_equal(X.shape[0], 2)
+    assert_equal(stats["skipped_lines"], 1)
+    assert_equal(stats["bad_lines"], [1])
+
+
+def test_csr_builder_append():
+    X, y = load_svmlight_file(datafile, n_features=21)
+    builder = CSRBuilder(n_features=21)
+    assert_equal(builder.append_file(datafile), 3)
+    assert_equal(builder.append_file(datafile), 3)
+    assert_equal(builder.n_rows, 6)
+
+    # snapshot leaves the builder growing
+    X2, y2 = builder.snapshot()
+    assert_array_equal(y2, np.concatenate([y, y]))
+    assert_array_equal(X2.toarray(), np.vstack([X.toarray(), X.toarray()]))
+
+    builder.append_file(datafile)
+    X3, y3 = builder.take()
+    assert_equal(X3.shape[0], 9)
+    assert_array_equal(X3.toarray()[3:6], X.toarray())
+
+    # take empties the builder
+    assert_equal(builder.n_rows, 0)
+    builder.append_file(datafile)
+    X4, y4 = builder.snapshot()
+    assert_array_equal(y4, y)
+
+
+def test_csr_builder_append_failure():
+    # A failed append rolls back to the last row boundary: the rows
+    # parsed before the bad line survive, the partial row does not.
+    # The stray qid errors only after the bad row's label and row
+    # start are already pushed, so it really exercises the rollback
+    # (a truncated value like "1:oops" would just end the line early).
+    tmpfile = "tmp_builder_bad.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1 1:1.0 3:2.0\n")
+            f.write("2 2:4.0\n")
+            f.write("3 qid:1 1:5.0\n")
+        builder = CSRBuilder(n_features=4)
+        try:
+            builder.append_file(tmpfile)
+            assert False, "append of a malformed file must raise"
+        except ValueError:
+            pass
+        X, y = builder.snapshot()
+        assert_array_equal(y, [1, 2])
+        assert_equal(X.shape, (2, 4))
+        assert_equal(X[0, 3], 2.0)
+
+        # ... and the builder keeps accepting appends afterwards.
+        with open(tmpfile, "w") as f:
+            f.write("3 1:5.0\n")
+        builder.append_file(tmpfile)
+        X2, y2 = builder.snapshot()
+        assert_array_equal(y2, [1, 2, 3])
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_unsorted_duplicate_indices():
+    tmpfile = "tmp_unsorted.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1 3:1.0 1:2.0 3:4.0 2:0.5\n")
+            f.write("2 1:1.0 2:2.0\n")
+            f.write("3 5:1.0 5:2.0 5:3.0\n")
+        X, y = load_svmlight_file(tmpfile, zero_based=False)
+        # Indices come back sorted with duplicates summed, so no
+        # sort_indices()/sum_duplicates() passes are needed.
+        assert X.has_sorted_indices
+        assert_array_equal(X.indices, [0, 1, 2, 0, 1, 4])
+        assert_array_equal(X.data, [2.0, 0.5, 5.0, 1.0, 2.0, 6.0])
+        assert_array_equal(X.indptr, [0, 3, 5, 6])
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_numa_policy():
+    # Placement is best effort, so on any machine the data must simply
+    # come back intact for both policies.
+    X, y = load_svmlight_file(datafile)
+    for policy in ("interleave", 0):
+        X2, y2 = load_svmlight_file(datafile, numa_policy=policy)
+        assert_array_equal(X.toarray(), X2.toarray())
+        assert_array_equal(y, y2)
+
+
+def test_load_format_csc():
+    X, y = load_svmlight_file(datafile)
+    X2, y2 = load_svmlight_file(datafile, format="csc")
+    assert sp.isspmatrix_csc(X2)
+    assert_equal(X2.shape, X.shape)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+    X3, y3 = load_svmlight_file(datafile, format="csc", n_features=25)
+    assert_equal(X3.shape[1], 25)
+
+
+def test_load_format_coo():
+    X, y = load_svmlight_file(datafile)
+    X2, y2 = load_svmlight_file(datafile, format="coo")
+    assert sp.isspmatrix_coo(X2)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+
+@raises(ValueError)
+def test_load_bad_sample_rate():
+    load_svmlight_file(datafile, sample_rate=1.5)
+
+
+@raises(ValueError)
+def test_load_mixed_query_id():
+    tmpfile = "tmp_qid_mixed.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1 qid:1 1:1.0\n")
+            f.write("1 2:1.0\n")
+        load_svmlight_file(tmpfile)
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_gzip_file():
+    import gzip
+    tmpfile = "tmp_compressed.txt.gz"
+    try:
+        with open(datafile, "rb") as src, gzip.open(tmpfile, "wb") as dst:
+            dst.write(src.read())
+        X, y = load_svmlight_file(datafile)
+        X2, y2 = load_svmlight_file(tmpfile)
+        assert_array_equal(X.toarray(), X2.toarray())
+        assert_array_equal(y, y2)
+    finally:
+        os.remove(tmpfile)
+
+
+def test_dump_gzip_file():
+    import gzip
+    tmpfile = "tmp_dump.txt.gz"
+    try:
+        Xs, y = load_svmlight_file(datafile)
+        dump_svmlight_file(Xs, y, tmpfile, zero_based=False)
+        with gzip.open(tmpfile, "rb") as f:
+            f.read()  # must be valid gzip
+        X2, y2 = load_svmlight_file(tmpfile)
+        assert_array_equal(Xs.toarray(), X2.toarray())
+        assert_array_equal(y, y2)
+    finally:
+        os.remove(tmpfile)
+
+
+def test_load_scientific_notation():
+    tmpfile = "tmp_scientific.txt"
+    try:
+        with open(tmpfile, "w") as f:
+            f.write("1.0 1:1e-3 3:-2.5E2 7:+4.25e1\n")
+            f.write("-1 2:0.1234567890123456789 5:3e300\n")
+        X, y = load_svmlight_file(tmpfile)
+        assert_array_equal(y, [1, -1])
+        assert_equal(X[0, 1], 1e-3)
+        assert_equal(X[0, 3], -2.5e2)
+        assert_equal(X[0, 7], 42.5)
+        assert_equal(X[1, 2], 0.1234567890123456789)
+        assert_equal(X[1, 5], 3e300)
+    finally:
+        os.remove(tmpfile)
+
+
 @raises(ValueError)
 def test_load_invalid_file():
     load_svmlight_file(invalidfile)
@@ -94,6 +621,36 @@ def test_invalid_filename():
     load_svmlight_file("trou pic nic douille")
 
 
+def test_dump_parallel():
+    tmpfile = "tmp_dump_serial.txt"
+    tmpfile2 = "tmp_dump_parallel.txt"
+    try:
+        Xs, y = load_svmlight_file(datafile)
+        dump_svmlight_file(Xs, y, tmpfile, zero_based=False)
+        dump_svmlight_file(Xs, y, tmpfile2, zero_based=False, n_threads=2)
+        with open(tmpfile) as f, open(tmpfile2) as f2:
+            assert_equal(f.read(), f2.read())
+    finally:
+        for f in (tmpfile, tmpfile2):
+            if os.path.exists(f):
+                os.remove(f)
+
+
+def test_dump_roundtrip_precision():
+    # The writer must emit enough digits for an exact round trip.
+    tmpfile = "tmp_dump_precision.txt"
+    try:
+        X = sp.csr_matrix(np.array([[0.1, 0.0, 1e-300],
+                                    [3.0, 0.7000000000000001, 0.0]]))
+        y = np.array([0.30000000000000004, -2.0])
+        dump_svmlight_file(X, y, tmpfile, zero_based=True)
+        X2, y2 = load_svmlight_file(tmpfile, n_features=3, zero_based=True)
+        assert_array_equal(X.toarray(), X2.toarray())
+        assert_array_equal(y, y2)
+    finally:
+        os.remove(tmpfile)
+
+
 def test_dump():
     try:
         Xs, y = load_svmlight_file(datafile)
@@ -105,3 +662,59 @@ def test_dump():
     finally:
         os.remove(tmpfile)
 
+
+def test_load_from_bytes():
+    with open(datafile, "rb") as f:
+        raw = f.read()
+    X, y = load_svmlight_file(datafile)
+    X2, y2 = load_svmlight_file(raw)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+    # memoryview hits the same zero-copy path
+    X3, y3 = load_svmlight_file(memoryview(raw))
+    assert_array_equal(X.toarray(), X3.toarray())
+
+
+def test_load_from_file_object():
+    X, y = load_svmlight_file(datafile)
+    with open(datafile, "rb") as f:
+        X2, y2 = load_svmlight_file(f)
+    assert_array_equal(X.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+
+def test_dump_to_fd():
+    tmpfile = "tmp_dump_fd.txt"
+    tmpfile2 = "tmp_dump_fd_ref.txt"
+    try:
+        Xs, y = load_svmlight_file(datafile)
+        dump_svmlight_file(Xs, y, tmpfile2, zero_based=False)
+        fd = os.open(tmpfile, os.O_WRONLY | os.O_CREAT | os.O_TRUNC)
+        try:
+            dump_svmlight_file(Xs, y, fd, zero_based=False)
+        finally:
+            os.close(fd)
+        with open(tmpfile) as f, open(tmpfile2) as f2:
+            assert_equal(f.read(), f2.read())
+    finally:
+        for f in (tmpfile, tmpfile2):
+            if os.path.exists(f):
+                os.remove(f)
+
+
+def test_dump_to_buffer():
+    Xs, y = load_svmlight_file(datafile)
+    buf = bytearray(1 << 16)
+    n_bytes = dump_svmlight_file(Xs, y, buf, zero_based=True)
+    assert n_bytes > 0
+    X2, y2 = load_svmlight_file(bytes(buf[:n_bytes]), n_features=Xs.shape[1],
+                                zero_based=True)
+    assert_array_equal(Xs.toarray(), X2.toarray())
+    assert_array_equal(y, y2)
+
+
+@raises(RuntimeError)
+def test_dump_to_small_buffer():
+    Xs, y = load_svmlight_file(datafile)
+    dump_svmlight_file(Xs, y, bytearray(4))
+